@@ -0,0 +1,141 @@
+#! /bin/sh
+# Desktop stress benchmark: starts pcmanfm desktop manager on headless Xvfb
+# display with generated desktop folders of various sizes, replays pointer
+# motion, rubber band selection, keyboard navigation and wallpaper changes,
+# and prints layout, paint (frame), navigation and wallpaper times and peak
+# RSS. The statistics are collected only if pcmanfm was configured with
+# --enable-debug.
+#
+# usage: desktop-bench.sh [PCMANFM [N...]]
+#
+# Requires Xvfb and xdotool, exits with status 77 (skipped) if they are not
+# found. Set BENCH_DISPLAY to use another display number than 99.
+
+PCMANFM=${1:-src/pcmanfm}
+[ $# -gt 0 ] && shift
+SIZES=${*:-"1000 10000 50000"}
+WIDTH=1920
+HEIGHT=1080
+
+srcdir=`dirname "$0"`
+
+for tool in Xvfb xdotool; do
+    if ! command -v $tool >/dev/null 2>&1; then
+        echo "$tool is not found, benchmark skipped"
+        exit 77
+    fi
+done
+if [ ! -x "$PCMANFM" ]; then
+    echo "$PCMANFM is not found, build it first" >&2
+    exit 1
+fi
+
+work=`mktemp -d "${TMPDIR:-/tmp}/pcmanfm-bench.XXXXXX"` || exit 1
+xvfb_pid=
+pcmanfm_pid=
+cleanup()
+{
+    [ -n "$pcmanfm_pid" ] && kill $pcmanfm_pid 2>/dev/null
+    [ -n "$xvfb_pid" ] && kill $xvfb_pid 2>/dev/null
+    rm -rf "$work"
+}
+trap cleanup EXIT
+trap 'exit 1' INT TERM
+
+# isolate pcmanfm from the user settings
+export HOME="$work/home"
+export XDG_CONFIG_HOME="$work/config"
+export XDG_CACHE_HOME="$work/cache"
+export XDG_DATA_HOME="$work/data"
+mkdir -p "$HOME" "$XDG_CONFIG_HOME/pcmanfm/bench" "$XDG_CACHE_HOME" "$XDG_DATA_HOME"
+
+export DISPLAY=":${BENCH_DISPLAY:-99}"
+Xvfb $DISPLAY -screen 0 ${WIDTH}x${HEIGHT}x24 -nolisten tcp >/dev/null 2>&1 &
+xvfb_pid=$!
+i=0
+until xdotool getdisplaygeometry >/dev/null 2>&1; do
+    i=`expr $i + 1`
+    if [ $i -gt 50 ]; then
+        echo "cannot start Xvfb on $DISPLAY" >&2
+        exit 1
+    fi
+    sleep 0.1
+done
+
+# wallpapers to switch between, PPM needs no tools to be generated
+for wp in 1 2; do
+    printf 'P6\n%d %d\n255\n' $WIDTH $HEIGHT > "$work/wallpaper$wp.ppm"
+    head -c `expr $WIDTH \* $HEIGHT \* 3` /dev/urandom >> "$work/wallpaper$wp.ppm"
+done
+
+# pointer motion over the whole screen in one xdotool call
+motion=
+x=0
+while [ $x -lt $WIDTH ]; do
+    motion="$motion mousemove $x `expr $x \* $HEIGHT / $WIDTH`"
+    x=`expr $x + 20`
+done
+
+keys=
+for k in Down Down Down Down Down Right Right Right Right Right \
+         Up Up Up Left Left Left End Home; do
+    keys="$keys $k $k $k"
+done
+
+for n in $SIZES; do
+    folder="$work/desktop-$n"
+    sh "$srcdir/gen-desktop-folder.sh" $n "$folder" || exit 1
+    rm -f "$XDG_CONFIG_HOME"/pcmanfm/bench/desktop-items-*
+    printf '[*]\nfolder=%s\nwallpaper_mode=color\n' "$folder" \
+        > "$XDG_CONFIG_HOME/pcmanfm/bench/desktop-items-0.conf"
+    log="$work/log-$n"
+
+    G_MESSAGES_DEBUG=all "$PCMANFM" --profile=bench --desktop >"$log" 2>&1 &
+    pcmanfm_pid=$!
+    # wait for the folder to be loaded and laid out
+    sleep `expr 2 + $n / 10000`
+
+    xdotool $motion
+    # rubber band from the bottom right corner where are no items
+    xdotool mousemove `expr $WIDTH - 5` `expr $HEIGHT - 5` mousedown 1 \
+            mousemove `expr $WIDTH / 2` `expr $HEIGHT / 2` \
+            mousemove 5 5 \
+            mousemove `expr $WIDTH / 3` `expr $HEIGHT / 3` mouseup 1
+    # keyboard navigation starting from the first item
+    xdotool mousemove 40 40 click 1
+    xdotool key --delay 20 $keys
+    # wallpaper switches
+    for mode in stretch crop center; do
+        for wp in 1 2; do
+            "$PCMANFM" --profile=bench --wallpaper-mode=$mode \
+                       --set-wallpaper="$work/wallpaper$wp.ppm"
+            sleep 0.5
+        done
+    done
+    "$PCMANFM" --profile=bench --wallpaper-mode=color
+    sleep 1
+
+    # statistics are logged when the desktop manager is finalized, which
+    # is done on --desktop-off but not on a signal; pcmanfm exits then
+    "$PCMANFM" --profile=bench --desktop-off
+    i=0
+    while kill -0 $pcmanfm_pid 2>/dev/null; do
+        i=`expr $i + 1`
+        if [ $i -gt 100 ]; then
+            echo "pcmanfm did not exit after --desktop-off" >&2
+            kill -TERM $pcmanfm_pid
+            break
+        fi
+        sleep 0.1
+    done
+    wait $pcmanfm_pid
+    pcmanfm_pid=
+
+    echo "=== $n items"
+    if grep -q 'desktop: peak RSS' "$log"; then
+        sed -n -e 's/^.*\(desktop [a-z]*: [0-9]* times.*\)$/\1/p' \
+               -e 's/^.*\(desktop: peak RSS.*\)$/\1/p' "$log"
+    else
+        echo "no statistics found, configure pcmanfm with --enable-debug"
+    fi
+done
@@ -0,0 +1,28 @@
+#! /bin/sh
+# Creates folder DIR with N items to be shown on the desktop. Every tenth
+# item is a folder and files have a few different types so icons differ.
+#
+# usage: gen-desktop-folder.sh N DIR
+
+if [ $# -ne 2 ]; then
+    echo "usage: $0 N DIR" >&2
+    exit 1
+fi
+
+n=$1
+dir=$2
+
+rm -rf "$dir"
+mkdir -p "$dir" || exit 1
+cd "$dir" || exit 1
+
+seq 1 "$n" | awk '
+    $1 % 10 == 0 { next }
+    $1 % 4 == 0 { printf "document-%05d.txt\n", $1; next }
+    $1 % 4 == 1 { printf "image-%05d.png\n", $1; next }
+    $1 % 4 == 2 { printf "archive-%05d.tar.gz\n", $1; next }
+    { printf "Item with a rather long name number %05d.pdf\n", $1 }
+' | tr '\n' '\0' | xargs -0 touch || exit 1
+
+seq 1 "$n" | awk '$1 % 10 == 0 { printf "folder-%05d\n", $1 }' \
+    | tr '\n' '\0' | xargs -0 -r mkdir || exit 1
@@ -483,6 +483,7 @@ static void fm_app_config_init(FmAppConfig *cfg)
     fm_config_load_from_file((FmConfig*)cfg, NULL);
 
     cfg->bm_open_method = FM_OPEN_IN_CURRENT_TAB;
+    cfg->wallpaper_cache_size = 128;
 
     cfg->mount_on_startup = TRUE;
     cfg->mount_removable = TRUE;
@@ -533,6 +534,9 @@ static void fm_app_config_init(FmAppConfig *cfg)
 #endif
     cfg->change_tab_on_drop = TRUE;
     cfg->close_on_unmount = TRUE;
+    cfg->lazy_tabs = FALSE;
+    cfg->tab_unload_timeout = 0;
+    cfg->folder_prefetch = TRUE;
     cfg->maximized = FALSE;
     cfg->pathbar_mode_buttons = FALSE;
 }
@@ -660,6 +664,8 @@ void fm_app_config_load_from_key_file(FmAppConfig* cfg, GKeyFile* kf)
 
     /* behavior */
     fm_key_file_get_int(kf, "config", "bm_open_method", &cfg->bm_open_method);
+    fm_key_file_get_int(kf, "config", "wallpaper_cache_size", &cfg->wallpaper_cache_size);
+    fm_key_file_get_bool(kf, "config", "desktop_share_model", &cfg->desktop_share_model);
     /*tmp = g_key_file_get_string(kf, "config", "su_cmd", NULL);
     g_free(cfg->su_cmd);
     cfg->su_cmd = tmp;*/
@@ -691,6 +697,9 @@ void fm_app_config_load_from_key_file(FmAppConfig* cfg, GKeyFile* kf)
     fm_key_file_get_bool(kf, "ui", "desktop_folder_new_win", &cfg->desktop_folder_new_win);
     fm_key_file_get_bool(kf, "ui", "change_tab_on_drop", &cfg->change_tab_on_drop);
     fm_key_file_get_bool(kf, "ui", "close_on_unmount", &cfg->close_on_unmount);
+    fm_key_file_get_bool(kf, "ui", "lazy_tabs", &cfg->lazy_tabs);
+    fm_key_file_get_int(kf, "ui", "tab_unload_timeout", &cfg->tab_unload_timeout);
+    fm_key_file_get_bool(kf, "ui", "folder_prefetch", &cfg->folder_prefetch);
 
 #if FM_CHECK_VERSION(1, 2, 0)
     fm_key_file_get_bool(kf, "ui", "focus_previous", &cfg->focus_previous);
@@ -1098,6 +1107,8 @@ void fm_app_config_save_profile(FmAppConfig* cfg, const char* name)
 
         g_string_append(buf, "[config]\n");
         g_string_append_printf(buf, "bm_open_method=%d\n", cfg->bm_open_method);
+        g_string_append_printf(buf, "wallpaper_cache_size=%d\n", cfg->wallpaper_cache_size);
+        g_string_append_printf(buf, "desktop_share_model=%d\n", cfg->desktop_share_model);
         /*if(cfg->su_cmd && *cfg->su_cmd)
             g_string_append_printf(buf, "su_cmd=%s\n", cfg->su_cmd);*/
 #if FM_CHECK_VERSION(1, 2, 0)
@@ -1130,6 +1141,9 @@ void fm_app_config_save_profile(FmAppConfig* cfg, const char* name)
         g_string_append_printf(buf, "desktop_folder_new_win=%d\n", cfg->desktop_folder_new_win);
         g_string_append_printf(buf, "change_tab_on_drop=%d\n", cfg->change_tab_on_drop);
         g_string_append_printf(buf, "close_on_unmount=%d\n", cfg->close_on_unmount);
+        g_string_append_printf(buf, "lazy_tabs=%d\n", cfg->lazy_tabs);
+        g_string_append_printf(buf, "tab_unload_timeout=%d\n", cfg->tab_unload_timeout);
+        g_string_append_printf(buf, "folder_prefetch=%d\n", cfg->folder_prefetch);
 #if FM_CHECK_VERSION(1, 2, 0)
         g_string_append_printf(buf, "focus_previous=%d\n", cfg->focus_previous);
         g_string_append(buf, "side_pane_mode=");
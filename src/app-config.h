@@ -106,6 +106,8 @@ struct _FmAppConfig
     FmConfig parent;
     /* config */
     int bm_open_method;
+    int wallpaper_cache_size; /* memory budget for wallpapers, in MiB */
+    gboolean desktop_share_model; /* desktops showing the same folder share one model */
 
     /* volume */
     gboolean mount_on_startup;
@@ -124,6 +126,9 @@ struct _FmAppConfig
     gboolean desktop_folder_new_win;
     gboolean change_tab_on_drop;
     gboolean close_on_unmount;
+    gboolean lazy_tabs; /* don't load folder of background tab until shown */
+    int tab_unload_timeout; /* minutes before hidden tab drops its folder */
+    gboolean folder_prefetch; /* load parent and history folders in advance */
 #if FM_CHECK_VERSION(1, 2, 0)
     gboolean focus_previous;
 #endif
@@ -29,15 +29,21 @@
 #include "pcmanfm.h"
 
 #include <glib/gi18n.h>
+#include <glib/gstdio.h>
 
 #include <gdk/gdkx.h>
 #include <gdk/gdkkeysyms.h>
 #include <X11/Xlib.h>
 #include <X11/Xatom.h>
 #include <math.h>
+#include <string.h>
 
 #include <cairo-xlib.h>
 
+#ifdef G_ENABLE_DEBUG
+#include <sys/resource.h>
+#endif
+
 #include "pref.h"
 #include "main-win.h"
 
@@ -53,26 +59,47 @@
 #define PADDING 6
 #define MARGIN  2
 
+/* size of a cell in the spatial index of items (in pixels) */
+#define GRID_CELL_SIZE 64
+
 /* the search dialog timeout (in ms) */
 #define DESKTOP_SEARCH_DIALOG_TIMEOUT (5000)
 
+typedef struct
+{
+    PangoLayout *layout; /* label shaped for current width, height and font */
+    PangoRectangle extents; /* logical extents of the layout in pixels */
+} FmDesktopLabel;
+
 struct _FmDesktopItem
 {
     FmFileInfo* fi;
     GdkRectangle area; /* position of the item on the desktop */
     GdkRectangle icon_rect;
     GdkRectangle text_rect;
+    GdkRectangle grid_rect; /* bounds the item is registered with in the grid */
+    GdkPoint nav_pos; /* position the item is sorted by in navigation index */
+    GdkPixbuf* icon; /* icon the item was last sized with, used for repaint */
+    cairo_surface_t* surface[2]; /* rendered icon: normal and selected state */
+    FmDesktopLabel* label; /* shaped display name, NULL until painted */
+    char* search_key; /* casefolded and normalized display name */
+    gint search_row; /* row in the model, valid while search index is valid */
     gboolean is_special : 1; /* is this a special item like "My Computer", mounted volume, or "Trash" */
     gboolean is_mount : 1; /* is this a mounted volume*/
     gboolean is_selected : 1;
     gboolean is_rubber_banded : 1;
     gboolean is_prelight : 1;
     gboolean fixed_pos : 1;
+    gboolean in_grid : 1;
+    gboolean size_valid : 1; /* sizes of icon_rect and text_rect are calculated */
+    gboolean changed : 1; /* item is in changed_items list */
+    FmDesktop* owner; /* desktop the item belongs to */
+    FmDesktopItem* next; /* item of the same row on another desktop */
 };
 
 struct _FmBackgroundCache
 {
-    FmBackgroundCache *next;
+    char *key; /* key in bg_cache, NULL if entry was dropped from cache */
     char *filename;
 #if GTK_CHECK_VERSION(3, 0, 0)
     cairo_surface_t *bg;
@@ -80,18 +107,26 @@ struct _FmBackgroundCache
     GdkPixmap *bg;
 #endif
     FmWallpaperMode wallpaper_mode;
-    time_t mtime;
+    gsize size; /* memory used by the image, in bytes */
+    gint n_users; /* number of desktops which show this image now */
+    GList *lru; /* link in bg_cache_lru */
 };
 
 static void queue_layout_items(FmDesktop* desktop);
+static void queue_config_save(FmDesktop *desktop);
+#if FM_CHECK_VERSION(1, 2, 0)
+static gboolean reconnect_shared_model(FmDesktop *desktop);
+#endif
+static void queue_layout_items_from(FmDesktop* desktop, gint row, gboolean resize);
 static void redraw_item(FmDesktop* desktop, FmDesktopItem* item);
+static void search_index_rename(FmDesktop* desktop, FmDesktopItem* item);
 
 static FmFileInfoList* _dup_selected_files(FmFolderView* fv);
 static FmPathList* _dup_selected_file_paths(FmFolderView* fv);
 static void _select_all(FmFolderView* fv);
 static void _unselect_all(FmFolderView* fv);
 
-static FmDesktopItem* hit_test(FmDesktop* self, GtkTreeIter *it, int x, int y);
+static FmDesktopItem* hit_test(FmDesktop* self, int x, int y);
 
 static void fm_desktop_view_init(FmFolderViewInterface* iface);
 
@@ -114,6 +149,11 @@ static GdkCursor* hand_cursor = NULL;
 
 static guint idle_config_save = 0;
 
+static GSList *pending_desktops = NULL; /* desktops not initialized yet */
+static guint idle_desktops_init = 0;
+
+static gboolean _forget_pending_desktop(FmDesktop *desktop);
+
 enum {
 #if N_FM_DND_DEST_DEFAULT_TARGETS > N_FM_DND_SRC_DEFAULT_TARGETS
     FM_DND_DEST_DESKTOP_ITEM = N_FM_DND_DEST_DEFAULT_TARGETS
@@ -160,8 +200,8 @@ typedef struct
 {
     GMount *mount; /* NULL for non-mounts */
     FmPath *path;
-    FmFileInfo *fi;
-    FmFileInfoJob *job;
+    FmFileInfo *fi; /* NULL until file info is retrieved */
+    gboolean added; /* item was added to folder models */
 } FmDesktopExtraItem;
 
 static FmDesktopExtraItem *documents = NULL;
@@ -174,10 +214,78 @@ static GSList *mounts = NULL;
 #endif
 
 
+#ifdef G_ENABLE_DEBUG
+/* ---------------------------------------------------------------------
+    performance statistics
+
+   Debug builds measure time spent in layout, painting, keyboard navigation
+   and wallpaper rendering so regressions can be seen running pcmanfm with
+   a big desktop folder; summary and peak memory use are logged on exit. */
+
+enum
+{
+    STAT_LAYOUT,
+    STAT_PAINT,
+    STAT_NAVIGATION,
+    STAT_WALLPAPER,
+    N_STATS
+};
+
+typedef struct
+{
+    const char *name;
+    guint count;
+    gdouble total; /* in seconds */
+    gdouble max;
+} FmDesktopStat;
+
+static FmDesktopStat stats[N_STATS] =
+{
+    { "layout", 0, 0.0, 0.0 },
+    { "paint", 0, 0.0, 0.0 },
+    { "navigation", 0, 0.0, 0.0 },
+    { "wallpaper", 0, 0.0, 0.0 }
+};
+
+/* under GDK lock */
+static void stat_add_time(int id, gdouble elapsed)
+{
+    FmDesktopStat *stat = &stats[id];
+
+    stat->count++;
+    stat->total += elapsed;
+    if (elapsed > stat->max)
+        stat->max = elapsed;
+}
+
+/* adds time elapsed by timer and destroys it */
+static void stat_add(int id, GTimer *timer)
+{
+    stat_add_time(id, g_timer_elapsed(timer, NULL));
+    g_timer_destroy(timer);
+}
+
+static void stats_report(void)
+{
+    struct rusage usage;
+    int i;
+
+    for (i = 0; i < N_STATS; i++)
+        if (stats[i].count > 0)
+            g_debug("desktop %s: %u times, average %.3f ms, max %.3f ms",
+                    stats[i].name, stats[i].count,
+                    stats[i].total * 1000.0 / stats[i].count,
+                    stats[i].max * 1000.0);
+    if (getrusage(RUSAGE_SELF, &usage) == 0)
+        g_debug("desktop: peak RSS %ld KiB", usage.ru_maxrss);
+}
+#endif
+
+
 /* ---------------------------------------------------------------------
     Items management and common functions */
 
-static char* get_config_file(FmDesktop* desktop, gboolean create_dir)
+static char* get_desktop_file(FmDesktop* desktop, const char* ext, gboolean create_dir)
 {
     char *dir, *path;
     int i;
@@ -188,274 +296,947 @@ static char* get_config_file(FmDesktop* desktop, gboolean create_dir)
     if(i >= n_screens)
         return NULL;
     dir = pcmanfm_get_profile_dir(create_dir);
-    path = g_strdup_printf("%s/desktop-items-%u.conf", dir, i);
+    path = g_strdup_printf("%s/desktop-items-%u.%s", dir, i, ext);
     g_free(dir);
     return path;
 }
 
-static inline FmDesktopItem* desktop_item_new(FmFolderModel* model, GtkTreeIter* it)
+static inline char* get_config_file(FmDesktop* desktop, gboolean create_dir)
 {
-    FmDesktopItem* item = g_slice_new0(FmDesktopItem);
-#if FM_CHECK_VERSION(1, 2, 0)
-    GSList *sl;
-#endif
-    fm_folder_model_set_item_userdata(model, it, item);
-    gtk_tree_model_get(GTK_TREE_MODEL(model), it, FM_FOLDER_MODEL_COL_INFO, &item->fi, -1);
-    fm_file_info_ref(item->fi);
-#if FM_CHECK_VERSION(1, 2, 0)
-    if ((trash_can && trash_can->fi == item->fi) ||
-        (documents && documents->fi == item->fi))
-        item->is_special = TRUE;
-    else for (sl = mounts; sl; sl = sl->next)
-        if (((FmDesktopExtraItem *)sl->data)->fi == item->fi)
-        {
-            item->is_special = TRUE;
-            item->is_mount = TRUE;
-            break;
-        }
-#endif
-    return item;
+    return get_desktop_file(desktop, "conf", create_dir);
 }
 
-static inline void desktop_item_free(FmDesktopItem* item)
+/* ---- positions store ----
+ * Positions of items are kept in the binary file desktop-items-N.pos which
+ * consists of a header and a sequence of records. Each record either sets
+ * position of an item or removes it, and later records override earlier
+ * ones. Changes are appended to the end of file so moving an icon doesn't
+ * rewrite the whole file, the file is compacted once it contains more
+ * outdated records than live ones. If the store doesn't exist yet or is
+ * broken then positions are imported from desktop-items-N.conf where they
+ * were kept before. */
+#define POS_STORE_MAGIC "PCMFMPOS"
+#define POS_STORE_MAGIC_LEN 8
+#define POS_STORE_VERSION 1
+#define POS_STORE_HEADER_LEN (POS_STORE_MAGIC_LEN + 4)
+/* record: type (1 byte), x, y (4 bytes each), name length (2 bytes), name;
+   all numbers are little endian */
+#define POS_RECORD_HEADER_LEN 11
+/* don't compact the store until it has at least this many outdated records */
+#define POS_STORE_MIN_JOURNAL 64
+
+enum
 {
-    if(item->fi)
-        fm_file_info_unref(item->fi);
-    g_slice_free(FmDesktopItem, item);
+    POS_RECORD_REMOVE,
+    POS_RECORD_SET
+};
+
+typedef struct
+{
+    gint x, y;
+} FmDesktopItemPos;
+
+static void _free_item_pos(gpointer data)
+{
+    g_slice_free(FmDesktopItemPos, data);
 }
 
-static void calc_item_size(FmDesktop* desktop, FmDesktopItem* item, GdkPixbuf* icon)
+static void pos_store_set(FmDesktop* desktop, const char* name, gint x, gint y)
 {
-    PangoRectangle rc2;
+    FmDesktopItemPos *pos = g_slice_new(FmDesktopItemPos);
 
-    /* icon rect */
-    if(icon)
-    {
-        item->icon_rect.width = gdk_pixbuf_get_width(icon);
-        item->icon_rect.height = gdk_pixbuf_get_height(icon);
-    }
-    else
-    {
-        item->icon_rect.width = fm_config->big_icon_size;
-        item->icon_rect.height = fm_config->big_icon_size;
-    }
-    item->icon_rect.x = item->area.x + (desktop->cell_w - item->icon_rect.width) / 2;
-    item->icon_rect.y = item->area.y + desktop->ypad + (fm_config->big_icon_size - item->icon_rect.height) / 2;
-    item->icon_rect.height += desktop->spacing; // FIXME: this is probably wrong
+    pos->x = x;
+    pos->y = y;
+    g_hash_table_replace(desktop->positions, g_strdup(name), pos);
+}
 
-    /* text label rect */
-    pango_layout_set_text(desktop->pl, NULL, 0);
-    pango_layout_set_height(desktop->pl, desktop->pango_text_h);
-    pango_layout_set_width(desktop->pl, desktop->pango_text_w);
-    pango_layout_set_text(desktop->pl, fm_file_info_get_disp_name(item->fi), -1);
+static void pos_store_add_record(GString* buf, guint8 type, const char* name,
+                                 gint x, gint y)
+{
+    gsize len = strlen(name);
+    guint32 v32;
+    guint16 v16;
 
-    pango_layout_get_pixel_extents(desktop->pl, NULL, &rc2);
-    pango_layout_set_text(desktop->pl, NULL, 0);
+    if (len > G_MAXUINT16) /* cannot be a file name */
+        return;
+    g_string_append_c(buf, type);
+    v32 = GUINT32_TO_LE((guint32)x);
+    g_string_append_len(buf, (const char*)&v32, 4);
+    v32 = GUINT32_TO_LE((guint32)y);
+    g_string_append_len(buf, (const char*)&v32, 4);
+    v16 = GUINT16_TO_LE((guint16)len);
+    g_string_append_len(buf, (const char*)&v16, 2);
+    g_string_append_len(buf, name, len);
+}
 
-    /* FIXME: RTL */
-    item->text_rect.x = item->area.x + (desktop->cell_w - rc2.width - 4) / 2;
-    item->text_rect.y = item->area.y + desktop->ypad + fm_config->big_icon_size + desktop->spacing;
-    item->text_rect.width = rc2.width + 4;
-    item->text_rect.height = rc2.y + rc2.height + 4;
-    item->area.width = (desktop->cell_w + MAX(item->icon_rect.width, item->text_rect.width)) / 2;
-    item->area.height = item->text_rect.y + item->text_rect.height - item->area.y;
+static GString* pos_store_new_buffer(void)
+{
+    GString *buf = g_string_sized_new(1024);
+    guint32 version = GUINT32_TO_LE(POS_STORE_VERSION);
+
+    g_string_append_len(buf, POS_STORE_MAGIC, POS_STORE_MAGIC_LEN);
+    g_string_append_len(buf, (const char*)&version, 4);
+    return buf;
 }
 
-/* unfortunately we cannot load the "*" together with items because
-   otherwise we will update pango layout on each load_items() which
-   is resource wasting so we load config file once more instead */
-static inline void load_config(FmDesktop* desktop)
+/* returns FALSE if data is not a valid store or has a record of unknown
+   type, n_records is number of records which were read; trailing
+   incomplete record (which may be left if pcmanfm was killed while
+   writing) is ignored and not counted in parsed length */
+static gboolean pos_store_parse(FmDesktop* desktop, const char* data, gsize len,
+                                guint* n_records, gsize* parsed)
 {
-    char* path;
-    GKeyFile* kf;
+    const char *start = data, *end = data + len;
+    guint32 v32;
+    guint16 v16;
 
-    path = get_config_file(desktop, FALSE);
-    if(!path)
-        return;
-    kf = g_key_file_new();
-    if(g_key_file_load_from_file(kf, path, 0, NULL))
-        /* item "*" is desktop config */
-        fm_app_config_load_desktop_config(kf, "*", &desktop->conf);
-    g_free(path);
-    g_key_file_free(kf);
+    *n_records = 0;
+    *parsed = 0;
+    if (len < POS_STORE_HEADER_LEN ||
+        memcmp(data, POS_STORE_MAGIC, POS_STORE_MAGIC_LEN) != 0)
+        return FALSE;
+    memcpy(&v32, data + POS_STORE_MAGIC_LEN, 4);
+    if (GUINT32_FROM_LE(v32) != POS_STORE_VERSION)
+        return FALSE;
+    data += POS_STORE_HEADER_LEN;
+    while (end - data >= POS_RECORD_HEADER_LEN)
+    {
+        guint8 type = data[0];
+        gint x, y;
+        char *name;
+
+        memcpy(&v32, data + 1, 4);
+        x = (gint)GUINT32_FROM_LE(v32);
+        memcpy(&v32, data + 5, 4);
+        y = (gint)GUINT32_FROM_LE(v32);
+        memcpy(&v16, data + 9, 2);
+        v16 = GUINT16_FROM_LE(v16);
+        if (end - data - POS_RECORD_HEADER_LEN < v16)
+            break;
+        /* unknown type means the store is damaged */
+        if (type != POS_RECORD_SET && type != POS_RECORD_REMOVE)
+            return FALSE;
+        name = g_strndup(data + POS_RECORD_HEADER_LEN, v16);
+        if (type == POS_RECORD_SET)
+            pos_store_set(desktop, name, x, y);
+        else
+            g_hash_table_remove(desktop->positions, name);
+        g_free(name);
+        data += POS_RECORD_HEADER_LEN + v16;
+        ++*n_records;
+    }
+    *parsed = data - start;
+    return TRUE;
 }
 
-static inline void load_items(FmDesktop* desktop)
+/* imports positions kept in desktop-items-N.conf by older versions */
+static gboolean pos_store_import(FmDesktop* desktop)
 {
-    GtkTreeIter it;
-    char* path;
-    GtkTreeModel* model;
-    GKeyFile* kf;
+    char *path = get_config_file(desktop, FALSE);
+    GKeyFile *kf;
+    char **groups;
+    gsize i, n = 0;
 
-    if (desktop->model == NULL)
-        return;
-    model = GTK_TREE_MODEL(desktop->model);
-    if (!gtk_tree_model_get_iter_first(model, &it))
-        return;
-    path = get_config_file(desktop, FALSE);
-    if(!path)
-        return;
+    if (!path)
+        return FALSE;
     kf = g_key_file_new();
-    if(g_key_file_load_from_file(kf, path, 0, NULL))
+    if (g_key_file_load_from_file(kf, path, 0, NULL))
     {
-        do
-        {
-            FmDesktopItem* item;
-            const char* name;
-            GdkPixbuf* icon = NULL;
-            int out; /* out of bounds */
-
-            item = fm_folder_model_get_item_userdata(desktop->model, &it);
-            name = fm_file_info_get_name(item->fi);
-            if(g_key_file_has_group(kf, name))
-            {
-                gtk_tree_model_get(model, &it, FM_FOLDER_MODEL_COL_ICON, &icon, -1);
-                desktop->fixed_items = g_list_prepend(desktop->fixed_items, item);
-                item->fixed_pos = TRUE;
-                item->area.x = g_key_file_get_integer(kf, name, "x", NULL);
-                item->area.y = g_key_file_get_integer(kf, name, "y", NULL);
-                /* pull item into screen bounds */
-                if (item->area.x < desktop->xmargin + desktop->working_area.x)
-                    item->area.x = desktop->xmargin + desktop->working_area.x;
-                if (item->area.y < desktop->ymargin + desktop->working_area.y)
-                    item->area.y = desktop->ymargin + desktop->working_area.y;
-                calc_item_size(desktop, item, icon);
-                /* check if item is in screen bounds and pull it if it's not */
-                out = item->area.x + item->area.width + desktop->xmargin - desktop->working_area.width - desktop->working_area.x;
-                if (out > 0)
-                {
-                    if (out > item->area.x - desktop->xmargin)
-                        out = item->area.x - desktop->xmargin;
-                    item->area.x -= out;
-                    item->icon_rect.x -= out;
-                    item->text_rect.x -= out;
-                }
-                out = item->area.y + item->area.height + desktop->ymargin - desktop->working_area.height - desktop->working_area.y;
-                if (out > 0)
-                {
-                    if (out > item->area.y - desktop->ymargin)
-                        out = item->area.y - desktop->ymargin;
-                    item->area.y -= out;
-                    item->icon_rect.y -= out;
-                    item->text_rect.y -= out;
-                }
-                if(icon)
-                    g_object_unref(icon);
-            }
-        }
-        while(gtk_tree_model_iter_next(model, &it));
+        groups = g_key_file_get_groups(kf, &n);
+        for (i = 0; i < n; i++)
+            if (strcmp(groups[i], "*") != 0) /* item "*" is desktop config */
+                pos_store_set(desktop, groups[i],
+                              g_key_file_get_integer(kf, groups[i], "x", NULL),
+                              g_key_file_get_integer(kf, groups[i], "y", NULL));
+        g_strfreev(groups);
     }
     g_free(path);
     g_key_file_free(kf);
-    queue_layout_items(desktop);
+    return n > 0;
 }
 
-static inline void unload_items(FmDesktop* desktop)
+/* rewrites the store with current positions only */
+static void pos_store_compact(FmDesktop* desktop)
 {
-    /* remove existing fixed items */
-    g_list_free(desktop->fixed_items);
-    desktop->fixed_items = NULL;
-    desktop->focus = NULL;
-    desktop->drop_hilight = NULL;
-    desktop->hover_item = NULL;
-    g_object_set(G_OBJECT(desktop), "tooltip-text", NULL, NULL);
+    char *path = get_desktop_file(desktop, "pos", TRUE);
+    GString *buf;
+    GHashTableIter it;
+    gpointer name, data;
+
+    if (!path)
+        return;
+    buf = pos_store_new_buffer();
+    g_hash_table_iter_init(&it, desktop->positions);
+    while (g_hash_table_iter_next(&it, &name, &data))
+    {
+        FmDesktopItemPos *pos = data;
+        pos_store_add_record(buf, POS_RECORD_SET, name, pos->x, pos->y);
+    }
+    g_file_set_contents(path, buf->str, buf->len, NULL);
+    g_free(path);
+    g_string_free(buf, TRUE);
+    desktop->pos_journal = 0;
 }
 
-static inline void reload_items(FmDesktop *desktop)
+static inline gboolean pos_store_needs_compact(FmDesktop* desktop)
 {
-    unload_items(desktop);
-    load_items(desktop);
+    return desktop->pos_journal > MAX(g_hash_table_size(desktop->positions),
+                                      POS_STORE_MIN_JOURNAL);
 }
 
-static gint get_desktop_for_root_window(GdkWindow *root)
+static void pos_store_load(FmDesktop* desktop)
 {
-    gint desktop = -1;
-    Atom ret_type;
-    gulong len, after;
-    int format;
-    guchar* prop;
+    char *path, *data, *backup;
+    gsize len, parsed;
+    guint n_records;
 
-    if(XGetWindowProperty(GDK_WINDOW_XDISPLAY(root), GDK_WINDOW_XID(root),
-                          XA_NET_CURRENT_DESKTOP, 0, 1, False, XA_CARDINAL, &ret_type,
-                          &format, &len, &after, &prop) == Success &&
-       prop != NULL)
+    if (desktop->positions)
+        return;
+    path = get_desktop_file(desktop, "pos", FALSE);
+    if (!path)
+        return;
+    desktop->positions = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                               g_free, _free_item_pos);
+    if (g_file_get_contents(path, &data, &len, NULL))
     {
-        desktop = (gint)*(guint32*)prop;
-        XFree(prop);
+        if (pos_store_parse(desktop, data, len, &n_records, &parsed))
+        {
+            g_free(data);
+            desktop->pos_journal = n_records - g_hash_table_size(desktop->positions);
+            /* drop outdated records and a broken tail if there is any */
+            if (parsed != len || pos_store_needs_compact(desktop))
+                pos_store_compact(desktop);
+            g_free(path);
+            return;
+        }
+        g_free(data);
+        /* forget records read before the damaged one */
+        g_hash_table_remove_all(desktop->positions);
+        /* don't overwrite the broken store, it may be restored by user */
+        backup = g_strconcat(path, ".backup", NULL);
+        g_unlink(backup);
+        if (g_rename(path, backup) == 0)
+            g_warning("desktop: %s is corrupted, moved it to %s", path, backup);
+        else
+            g_warning("desktop: %s is corrupted, positions of icons are lost", path);
+        g_free(backup);
     }
-    return desktop;
+    /* the store is missing or broken, try positions from the config file */
+    if (pos_store_import(desktop))
+    {
+        pos_store_compact(desktop);
+        /* positions should not be kept in the config file anymore */
+        if (desktop->conf.configured)
+            queue_config_save(desktop);
+    }
+    g_free(path);
 }
 
-/* save position of desktop icons */
-static void save_item_pos(FmDesktop* desktop)
+/* writes changed positions of fixed items into the store */
+static void pos_store_sync(FmDesktop* desktop)
 {
-    GList* l;
-    GString* buf;
-    char* path = get_config_file(desktop, TRUE);
+    GHashTable *fixed;
+    GHashTableIter it;
+    gpointer name, data;
+    GString *buf;
+    GList *l;
+    char *path;
+    FILE *f;
+    gboolean ok = FALSE;
 
-    if(!path)
+    desktop->items_changed = FALSE;
+    pos_store_load(desktop);
+    if (!desktop->positions)
         return;
-    buf = g_string_sized_new(1024);
-
-    /* save desktop config */
-    if (desktop->conf.configured)
+    buf = g_string_sized_new(256);
+    fixed = g_hash_table_new(g_str_hash, g_str_equal);
+    for (l = desktop->fixed_items; l; l = l->next)
     {
-        fm_app_config_save_desktop_config(buf, "*", &desktop->conf);
-        g_string_append_c(buf, '\n');
-    }
+        FmDesktopItem *item = l->data;
+        const char *basename = fm_path_get_basename(fm_file_info_get_path(item->fi));
+        FmDesktopItemPos *pos = g_hash_table_lookup(desktop->positions, basename);
 
-    /* save all items positions */
-    for(l = desktop->fixed_items; l; l=l->next)
+        g_hash_table_insert(fixed, (gpointer)basename, item);
+        if (pos && pos->x == item->area.x && pos->y == item->area.y)
+            continue;
+        if (pos) /* previous record becomes outdated */
+            desktop->pos_journal++;
+        pos_store_add_record(buf, POS_RECORD_SET, basename, item->area.x, item->area.y);
+        pos_store_set(desktop, basename, item->area.x, item->area.y);
+    }
+    /* forget items which aren't fixed anymore, but only when the folder
+       is completely loaded, otherwise we would lose not loaded items */
+    if (desktop->model && fm_folder_is_loaded(fm_folder_model_get_folder(desktop->model)))
+    {
+        g_hash_table_iter_init(&it, desktop->positions);
+        while (g_hash_table_iter_next(&it, &name, &data))
+            if (g_hash_table_lookup(fixed, name) == NULL)
+            {
+                pos_store_add_record(buf, POS_RECORD_REMOVE, name, 0, 0);
+                g_hash_table_iter_remove(&it);
+                desktop->pos_journal += 2;
+            }
+    }
+    g_hash_table_destroy(fixed);
+    if (buf->len > 0 && !pos_store_needs_compact(desktop))
     {
-        FmDesktopItem* item = (FmDesktopItem*)l->data;
-        FmPath* fi_path = fm_file_info_get_path(item->fi);
-        const char* p;
-        /* write the file basename as group name */
-        g_string_append_c(buf, '[');
-        for(p = fm_path_get_basename(fi_path); *p; ++p)
+        /* append changes to the journal */
+        path = get_desktop_file(desktop, "pos", TRUE);
+        if (path && g_file_test(path, G_FILE_TEST_IS_REGULAR))
         {
-            switch(*p)
+            f = g_fopen(path, "ab");
+            if (f)
             {
-            case '\r':
-                g_string_append(buf, "\\r");
-                break;
-            case '\n':
-                g_string_append(buf, "\\n");
-                break;
-            case '\\':
-                g_string_append(buf, "\\\\");
-                break;
-            case '[':
-                g_string_append(buf, "\\[");
-                break;
-            case ']':
-                g_string_append(buf, "\\]");
-                break;
-            default:
-                g_string_append_c(buf, *p);
+                ok = (fwrite(buf->str, 1, buf->len, f) == buf->len);
+                if (fclose(f) != 0)
+                    ok = FALSE;
             }
         }
-        g_string_append(buf, "]\n");
-        g_string_append_printf(buf, "x=%d\n"
-                                    "y=%d\n\n",
-                                    item->area.x, item->area.y);
+        g_free(path);
     }
-    g_file_set_contents(path, buf->str, buf->len, NULL);
-    g_free(path);
+    else
+        ok = (buf->len == 0);
+    /* rewrite the store if it's too fragmented or cannot be appended */
+    if (!ok)
+        pos_store_compact(desktop);
     g_string_free(buf, TRUE);
-    desktop->conf.changed = FALSE; /* reset it since we saved it */
 }
 
-static gboolean on_config_save_idle(gpointer _unused)
+/* ---- items of the model ----
+ * If the model is shared by few desktops then each row has an item for each
+ * of them, the items are chained and the first of them is the row userdata. */
+static inline FmDesktopItem* desktop_item_get(FmDesktop* desktop, GtkTreeIter* it)
 {
-    int i;
+    FmDesktopItem* item = fm_folder_model_get_item_userdata(desktop->model, it);
 
-    if (g_source_is_destroyed(g_main_current_source()))
-        return FALSE;
+    while (item && item->owner != desktop)
+        item = item->next;
+    return item;
+}
 
-    for (i = 0; i < n_screens; i++)
-        if (desktops[i]->conf.changed)
-            save_item_pos(desktops[i]);
+static void desktop_item_unlink(FmFolderModel* model, GtkTreeIter* it,
+                                FmDesktopItem* item)
+{
+    FmDesktopItem* prev = fm_folder_model_get_item_userdata(model, it);
+
+    if (prev == item)
+        fm_folder_model_set_item_userdata(model, it, item->next);
+    else
+    {
+        while (prev && prev->next != item)
+            prev = prev->next;
+        if (prev)
+            prev->next = item->next;
+    }
+    item->next = NULL;
+}
+
+static inline FmDesktopItem* desktop_item_new(FmDesktop* desktop, FmFolderModel* model,
+                                              GtkTreeIter* it)
+{
+    FmDesktopItem* item = g_slice_new0(FmDesktopItem);
+#if FM_CHECK_VERSION(1, 2, 0)
+    GSList *sl;
+#endif
+    item->owner = desktop;
+    item->next = fm_folder_model_get_item_userdata(model, it);
+    fm_folder_model_set_item_userdata(model, it, item);
+    gtk_tree_model_get(GTK_TREE_MODEL(model), it, FM_FOLDER_MODEL_COL_INFO, &item->fi, -1);
+    fm_file_info_ref(item->fi);
+#if FM_CHECK_VERSION(1, 2, 0)
+    if ((trash_can && trash_can->fi == item->fi) ||
+        (documents && documents->fi == item->fi))
+        item->is_special = TRUE;
+    else for (sl = mounts; sl; sl = sl->next)
+        if (((FmDesktopExtraItem *)sl->data)->fi == item->fi)
+        {
+            item->is_special = TRUE;
+            item->is_mount = TRUE;
+            break;
+        }
+#endif
+    return item;
+}
+
+static void _free_label(FmDesktopLabel *label)
+{
+    g_object_unref(label->layout);
+    g_slice_free(FmDesktopLabel, label);
+}
+
+static inline void desktop_item_free(FmDesktopItem* item)
+{
+    if(item->fi)
+        fm_file_info_unref(item->fi);
+    if(item->icon)
+        g_object_unref(item->icon);
+    if(item->surface[0])
+        cairo_surface_destroy(item->surface[0]);
+    if(item->surface[1])
+        cairo_surface_destroy(item->surface[1]);
+    if(item->label)
+        _free_label(item->label);
+    g_free(item->search_key);
+    g_slice_free(FmDesktopItem, item);
+}
+
+/* ---- spatial index of items ----
+ * The desktop is divided into GRID_CELL_SIZE x GRID_CELL_SIZE cells and each
+ * cell keeps a list of items which overlap it, so hit-testing and rectangle
+ * lookups don't have to walk the whole folder model. */
+static inline guint grid_cell_coord(int v)
+{
+    return (v < 0) ? 0 : MIN((guint)v / GRID_CELL_SIZE, 0xffff);
+}
+
+#define GRID_KEY(cx, cy) GUINT_TO_POINTER(((cy) << 16) | (cx))
+
+static void grid_remove_item(FmDesktop* desktop, FmDesktopItem* item)
+{
+    guint x, y, x1, y1, x2, y2;
+    GSList *list, *new_list;
+
+    if (!item->in_grid || desktop->grid == NULL)
+        return;
+    x1 = grid_cell_coord(item->grid_rect.x);
+    y1 = grid_cell_coord(item->grid_rect.y);
+    x2 = grid_cell_coord(item->grid_rect.x + item->grid_rect.width - 1);
+    y2 = grid_cell_coord(item->grid_rect.y + item->grid_rect.height - 1);
+    for (y = y1; y <= y2; y++)
+        for (x = x1; x <= x2; x++)
+        {
+            list = g_hash_table_lookup(desktop->grid, GRID_KEY(x, y));
+            new_list = g_slist_remove(list, item);
+            if (new_list == NULL)
+                g_hash_table_remove(desktop->grid, GRID_KEY(x, y));
+            else if (new_list != list)
+                g_hash_table_insert(desktop->grid, GRID_KEY(x, y), new_list);
+        }
+    item->in_grid = FALSE;
+}
+
+/* (re)register the item in the grid, should be called each time item rects
+   are changed */
+static void grid_update_item(FmDesktop* desktop, FmDesktopItem* item)
+{
+    guint x, y, x1, y1, x2, y2;
+    GSList *list;
+
+    /* navigation index is outdated only if the item was moved */
+    if (item->area.x != item->nav_pos.x || item->area.y != item->nav_pos.y)
+        desktop->nav_valid = FALSE;
+    if (desktop->grid == NULL)
+        return;
+    grid_remove_item(desktop, item);
+    gdk_rectangle_union(&item->icon_rect, &item->text_rect, &item->grid_rect);
+    if (item->grid_rect.width <= 0 || item->grid_rect.height <= 0)
+        return;
+    x1 = grid_cell_coord(item->grid_rect.x);
+    y1 = grid_cell_coord(item->grid_rect.y);
+    x2 = grid_cell_coord(item->grid_rect.x + item->grid_rect.width - 1);
+    y2 = grid_cell_coord(item->grid_rect.y + item->grid_rect.height - 1);
+    for (y = y1; y <= y2; y++)
+        for (x = x1; x <= x2; x++)
+        {
+            list = g_hash_table_lookup(desktop->grid, GRID_KEY(x, y));
+            g_hash_table_insert(desktop->grid, GRID_KEY(x, y),
+                                g_slist_prepend(list, item));
+        }
+    item->in_grid = TRUE;
+}
+
+static void _grid_free_cell(gpointer key, gpointer value, gpointer user_data)
+{
+    GSList *l;
+
+    for (l = value; l; l = l->next)
+        ((FmDesktopItem*)l->data)->in_grid = FALSE;
+    g_slist_free(value);
+}
+
+static void grid_clear(FmDesktop* desktop)
+{
+    desktop->nav_valid = FALSE;
+    if (desktop->grid == NULL)
+        return;
+    g_hash_table_foreach(desktop->grid, _grid_free_cell, NULL);
+    g_hash_table_remove_all(desktop->grid);
+}
+
+/* returns list of items which may intersect the rectangle, each item is
+   listed only once; returned list should be freed with g_list_free() */
+static GList* grid_query_rect(FmDesktop* desktop, const GdkRectangle* rect)
+{
+    guint x, y, x1, y1, x2, y2;
+    GSList *l;
+    GList *items = NULL;
+
+    if (desktop->grid == NULL || rect->width <= 0 || rect->height <= 0)
+        return NULL;
+    x1 = grid_cell_coord(rect->x);
+    y1 = grid_cell_coord(rect->y);
+    x2 = grid_cell_coord(rect->x + rect->width - 1);
+    y2 = grid_cell_coord(rect->y + rect->height - 1);
+    for (y = y1; y <= y2; y++)
+        for (x = x1; x <= x2; x++)
+            for (l = g_hash_table_lookup(desktop->grid, GRID_KEY(x, y)); l; l = l->next)
+            {
+                FmDesktopItem *item = l->data;
+                /* report the item only in the first cell of the query
+                   which it overlaps, this avoids duplicates */
+                if (MAX(grid_cell_coord(item->grid_rect.x), x1) == x &&
+                    MAX(grid_cell_coord(item->grid_rect.y), y1) == y)
+                    items = g_list_prepend(items, item);
+            }
+    return items;
+}
+
+/* ---- navigation index ----
+ * For keyboard navigation items are kept sorted by columns (x, then y) and
+ * by rows (y, then x), so nearest item in any direction is found with binary
+ * search. The index is invalidated when rows are added or removed or some
+ * item is moved, and rebuilt on demand, so it is built once while user walks
+ * through items. */
+static inline gint _nav_key(const FmDesktopItem* item, gboolean by_y, gboolean primary)
+{
+    return (by_y == primary) ? item->area.y : item->area.x;
+}
+
+static gint _nav_compare(const FmDesktopItem* item, gboolean by_y, gint p, gint s)
+{
+    gint v = _nav_key(item, by_y, TRUE);
+
+    if (v == p)
+    {
+        v = _nav_key(item, by_y, FALSE);
+        if (v == s)
+            return 0;
+        return (v < s) ? -1 : 1;
+    }
+    return (v < p) ? -1 : 1;
+}
+
+static gint _nav_sort_by_x(gconstpointer a, gconstpointer b)
+{
+    const FmDesktopItem *item = *(FmDesktopItem**)b;
+    return _nav_compare(*(FmDesktopItem**)a, FALSE, item->area.x, item->area.y);
+}
+
+static gint _nav_sort_by_y(gconstpointer a, gconstpointer b)
+{
+    const FmDesktopItem *item = *(FmDesktopItem**)b;
+    return _nav_compare(*(FmDesktopItem**)a, TRUE, item->area.y, item->area.x);
+}
+
+static void nav_index_update(FmDesktop* desktop)
+{
+    GtkTreeModel* model = desktop->model ? GTK_TREE_MODEL(desktop->model) : NULL;
+    GtkTreeIter it;
+
+    if (desktop->nav_valid)
+        return;
+    g_ptr_array_set_size(desktop->nav_x, 0);
+    g_ptr_array_set_size(desktop->nav_y, 0);
+    if(model && gtk_tree_model_get_iter_first(model, &it)) do
+    {
+        FmDesktopItem* item = desktop_item_get(desktop, &it);
+        item->nav_pos.x = item->area.x;
+        item->nav_pos.y = item->area.y;
+        g_ptr_array_add(desktop->nav_x, item);
+        g_ptr_array_add(desktop->nav_y, item);
+    }
+    while(gtk_tree_model_iter_next(model, &it));
+    g_ptr_array_sort(desktop->nav_x, _nav_sort_by_x);
+    g_ptr_array_sort(desktop->nav_y, _nav_sort_by_y);
+    desktop->nav_valid = TRUE;
+}
+
+/* returns index of first item in the sorted index with key greater than
+   (p, s) if upper is TRUE, or not less than (p, s) otherwise */
+static guint nav_index_bound(GPtrArray* index, gboolean by_y, gint p, gint s,
+                             gboolean upper)
+{
+    guint lo = 0, hi = index->len, mid;
+    gint res;
+
+    while (lo < hi)
+    {
+        mid = lo + (hi - lo) / 2;
+        res = _nav_compare(g_ptr_array_index(index, mid), by_y, p, s);
+        if (res < 0 || (upper && res == 0))
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+/* finds the item in the nearest column (or row if by_y is TRUE) before or
+   after the position p, and the nearest to position s within it */
+static FmDesktopItem* nav_index_find(FmDesktop* desktop, gboolean by_y,
+                                     gboolean forward, gint p, gint s)
+{
+    GPtrArray *index = by_y ? desktop->nav_y : desktop->nav_x;
+    FmDesktopItem *item, *prev;
+    guint start, end, i;
+
+    nav_index_update(desktop);
+    if (forward)
+    {
+        start = nav_index_bound(index, by_y, p, G_MAXINT, TRUE);
+        if (start >= index->len)
+            return NULL;
+        p = _nav_key(g_ptr_array_index(index, start), by_y, TRUE);
+        end = nav_index_bound(index, by_y, p, G_MAXINT, TRUE);
+    }
+    else
+    {
+        end = nav_index_bound(index, by_y, p, G_MININT, FALSE);
+        if (end == 0)
+            return NULL;
+        p = _nav_key(g_ptr_array_index(index, end - 1), by_y, TRUE);
+        start = nav_index_bound(index, by_y, p, G_MININT, FALSE);
+    }
+    /* items in [start, end) are in the same column, sorted by s */
+    i = nav_index_bound(index, by_y, p, s, FALSE);
+    if (i >= end)
+        return g_ptr_array_index(index, end - 1);
+    item = g_ptr_array_index(index, i);
+    if (i == start)
+        return item;
+    prev = g_ptr_array_index(index, i - 1);
+    if (s - _nav_key(prev, by_y, FALSE) <= _nav_key(item, by_y, FALSE) - s)
+        return prev;
+    return item;
+}
+
+/* ---- labels cache ----
+ * Shaping text is expensive so label is shaped once and kept in the item
+ * until its display name, font or label size is changed. */
+static FmDesktopLabel* get_item_label(FmDesktop* desktop, FmDesktopItem* item)
+{
+    FmDesktopLabel *label = item->label;
+
+    if (label == NULL)
+    {
+        label = g_slice_new(FmDesktopLabel);
+        /* the copy inherits font, alignment, wrapping and ellipsizing */
+        label->layout = pango_layout_copy(desktop->pl);
+        pango_layout_set_height(label->layout, desktop->pango_text_h);
+        pango_layout_set_width(label->layout, desktop->pango_text_w);
+        pango_layout_set_text(label->layout, fm_file_info_get_disp_name(item->fi), -1);
+        pango_layout_get_pixel_extents(label->layout, NULL, &label->extents);
+        item->label = label;
+    }
+    return label;
+}
+
+static void invalidate_item_label(FmDesktopItem* item)
+{
+    if (item->label)
+        _free_label(item->label);
+    item->label = NULL;
+}
+
+/* should be called each time font or parameters of desktop->pl are changed */
+static void invalidate_labels(FmDesktop* desktop)
+{
+    GtkTreeModel* model = desktop->model ? GTK_TREE_MODEL(desktop->model) : NULL;
+    GtkTreeIter it;
+
+    if(model && gtk_tree_model_get_iter_first(model, &it)) do
+    {
+        FmDesktopItem* item = desktop_item_get(desktop, &it);
+        if (item)
+            invalidate_item_label(item);
+    }
+    while(gtk_tree_model_iter_next(model, &it));
+}
+
+/* ---- icons cache ----
+ * Rendering the icon with emblems and state shading is done once and result
+ * is kept in the item until icon or file info is changed, so repaint is just
+ * a copy of the surface. */
+static void invalidate_item_icon(FmDesktopItem* item)
+{
+    if (item->surface[0])
+        cairo_surface_destroy(item->surface[0]);
+    if (item->surface[1])
+        cairo_surface_destroy(item->surface[1]);
+    item->surface[0] = item->surface[1] = NULL;
+}
+
+static void invalidate_icons(FmDesktop* desktop)
+{
+    GtkTreeModel* model = desktop->model ? GTK_TREE_MODEL(desktop->model) : NULL;
+    GtkTreeIter it;
+
+    if(model && gtk_tree_model_get_iter_first(model, &it)) do
+    {
+        FmDesktopItem* item = desktop_item_get(desktop, &it);
+        if (item)
+            invalidate_item_icon(item);
+    }
+    while(gtk_tree_model_iter_next(model, &it));
+}
+
+/* returns NULL if icon cannot be cached, item should be painted directly then */
+static cairo_surface_t* get_item_icon(FmDesktop* desktop, FmDesktopItem* item,
+                                      GtkCellRendererState state)
+{
+    GtkWidget* widget = GTK_WIDGET(desktop);
+    int i = (state & GTK_CELL_RENDERER_SELECTED) ? 1 : 0;
+    cairo_surface_t* surface = item->surface[i];
+    GdkRectangle rect;
+    cairo_t* cr;
+#if !GTK_CHECK_VERSION(3, 0, 0)
+    GdkScreen* screen;
+    GdkColormap* cmap;
+    GdkPixmap* pixmap;
+#endif
+
+    if (surface)
+    {
+        /* icon_rect includes spacing so it may be changed with the same icon */
+        if (cairo_image_surface_get_width(surface) == item->icon_rect.width &&
+            cairo_image_surface_get_height(surface) == item->icon_rect.height)
+            return surface;
+        cairo_surface_destroy(surface);
+        item->surface[i] = NULL;
+    }
+    if (item->icon_rect.width <= 0 || item->icon_rect.height <= 0)
+        return NULL;
+    rect.x = rect.y = 0;
+    rect.width = item->icon_rect.width;
+    rect.height = item->icon_rect.height;
+    g_object_set(desktop->icon_render, "pixbuf", item->icon, "info", item->fi, NULL);
+#if GTK_CHECK_VERSION(3, 0, 0)
+    surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, rect.width, rect.height);
+    cr = cairo_create(surface);
+    gtk_cell_renderer_render(GTK_CELL_RENDERER(desktop->icon_render), cr, widget, &rect, &rect, state);
+    cairo_destroy(cr);
+#else
+    /* renderer can draw only on drawable so use pixmap with alpha channel */
+    screen = gtk_widget_get_screen(widget);
+    cmap = gdk_screen_get_rgba_colormap(screen);
+    if (cmap == NULL)
+        return NULL;
+    pixmap = gdk_pixmap_new(gdk_screen_get_root_window(screen), rect.width, rect.height, 32);
+    gdk_drawable_set_colormap(pixmap, cmap);
+    cr = gdk_cairo_create(pixmap);
+    cairo_set_operator(cr, CAIRO_OPERATOR_CLEAR);
+    cairo_paint(cr);
+    cairo_destroy(cr);
+    gtk_cell_renderer_render(GTK_CELL_RENDERER(desktop->icon_render), pixmap, widget, &rect, &rect, &rect, state);
+    surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, rect.width, rect.height);
+    cr = cairo_create(surface);
+    gdk_cairo_set_source_pixmap(cr, pixmap, 0, 0);
+    cairo_set_operator(cr, CAIRO_OPERATOR_SOURCE);
+    cairo_paint(cr);
+    cairo_destroy(cr);
+    g_object_unref(pixmap);
+#endif
+    item->surface[i] = surface;
+    return surface;
+}
+
+static void calc_item_size(FmDesktop* desktop, FmDesktopItem* item, GdkPixbuf* icon)
+{
+    PangoRectangle rc2;
+
+    /* keep the icon so repaint don't need to query the model */
+    if(icon != item->icon)
+        invalidate_item_icon(item);
+    if(icon)
+        g_object_ref(icon);
+    if(item->icon)
+        g_object_unref(item->icon);
+    item->icon = icon;
+
+    /* icon rect */
+    if(icon)
+    {
+        item->icon_rect.width = gdk_pixbuf_get_width(icon);
+        item->icon_rect.height = gdk_pixbuf_get_height(icon);
+    }
+    else
+    {
+        item->icon_rect.width = fm_config->big_icon_size;
+        item->icon_rect.height = fm_config->big_icon_size;
+    }
+    item->icon_rect.x = item->area.x + (desktop->cell_w - item->icon_rect.width) / 2;
+    item->icon_rect.y = item->area.y + desktop->ypad + (fm_config->big_icon_size - item->icon_rect.height) / 2;
+    item->icon_rect.height += desktop->spacing; // FIXME: this is probably wrong
+
+    /* text label rect */
+    rc2 = get_item_label(desktop, item)->extents;
+
+    /* FIXME: RTL */
+    item->text_rect.x = item->area.x + (desktop->cell_w - rc2.width - 4) / 2;
+    item->text_rect.y = item->area.y + desktop->ypad + fm_config->big_icon_size + desktop->spacing;
+    item->text_rect.width = rc2.width + 4;
+    item->text_rect.height = rc2.y + rc2.height + 4;
+    item->area.width = (desktop->cell_w + MAX(item->icon_rect.width, item->text_rect.width)) / 2;
+    item->area.height = item->text_rect.y + item->text_rect.height - item->area.y;
+    item->size_valid = TRUE;
+    grid_update_item(desktop, item);
+}
+
+/* unfortunately we cannot load the "*" together with items because
+   otherwise we will update pango layout on each load_items() which
+   is resource wasting so we load config file once more instead */
+static inline void load_config(FmDesktop* desktop)
+{
+    char* path;
+    GKeyFile* kf;
+
+    path = get_config_file(desktop, FALSE);
+    if(!path)
+        return;
+    kf = g_key_file_new();
+    if(g_key_file_load_from_file(kf, path, 0, NULL))
+        /* item "*" is desktop config */
+        fm_app_config_load_desktop_config(kf, "*", &desktop->conf);
+    g_free(path);
+    g_key_file_free(kf);
+}
+
+static inline void load_items(FmDesktop* desktop)
+{
+    GtkTreeIter it;
+    GtkTreeModel* model;
+
+    if (desktop->model == NULL)
+        return;
+    model = GTK_TREE_MODEL(desktop->model);
+    if (!gtk_tree_model_get_iter_first(model, &it))
+        return;
+    pos_store_load(desktop);
+    if(desktop->positions && g_hash_table_size(desktop->positions) > 0)
+    {
+        do
+        {
+            FmDesktopItem* item;
+            FmDesktopItemPos* pos;
+            GdkPixbuf* icon = NULL;
+            int out; /* out of bounds */
+
+            item = desktop_item_get(desktop, &it);
+            pos = g_hash_table_lookup(desktop->positions, fm_file_info_get_name(item->fi));
+            if(pos)
+            {
+                gtk_tree_model_get(model, &it, FM_FOLDER_MODEL_COL_ICON, &icon, -1);
+                desktop->fixed_items = g_list_prepend(desktop->fixed_items, item);
+                item->fixed_pos = TRUE;
+                item->area.x = pos->x;
+                item->area.y = pos->y;
+                /* pull item into screen bounds */
+                if (item->area.x < desktop->xmargin + desktop->working_area.x)
+                    item->area.x = desktop->xmargin + desktop->working_area.x;
+                if (item->area.y < desktop->ymargin + desktop->working_area.y)
+                    item->area.y = desktop->ymargin + desktop->working_area.y;
+                calc_item_size(desktop, item, icon);
+                /* check if item is in screen bounds and pull it if it's not */
+                out = item->area.x + item->area.width + desktop->xmargin - desktop->working_area.width - desktop->working_area.x;
+                if (out > 0)
+                {
+                    if (out > item->area.x - desktop->xmargin)
+                        out = item->area.x - desktop->xmargin;
+                    item->area.x -= out;
+                    item->icon_rect.x -= out;
+                    item->text_rect.x -= out;
+                }
+                out = item->area.y + item->area.height + desktop->ymargin - desktop->working_area.height - desktop->working_area.y;
+                if (out > 0)
+                {
+                    if (out > item->area.y - desktop->ymargin)
+                        out = item->area.y - desktop->ymargin;
+                    item->area.y -= out;
+                    item->icon_rect.y -= out;
+                    item->text_rect.y -= out;
+                }
+                grid_update_item(desktop, item);
+                if(icon)
+                    g_object_unref(icon);
+            }
+        }
+        while(gtk_tree_model_iter_next(model, &it));
+    }
+    queue_layout_items(desktop);
+}
+
+static inline void unload_items(FmDesktop* desktop)
+{
+    /* remove existing fixed items */
+    g_list_free(desktop->fixed_items);
+    desktop->fixed_items = NULL;
+    desktop->focus = NULL;
+    desktop->drop_hilight = NULL;
+    desktop->hover_item = NULL;
+    g_object_set(G_OBJECT(desktop), "tooltip-text", NULL, NULL);
+}
+
+static inline void reload_items(FmDesktop *desktop)
+{
+    /* don't lose positions which weren't saved yet */
+    if (desktop->items_changed)
+        pos_store_sync(desktop);
+    unload_items(desktop);
+    load_items(desktop);
+}
+
+static gint get_desktop_for_root_window(GdkWindow *root)
+{
+    gint desktop = -1;
+    Atom ret_type;
+    gulong len, after;
+    int format;
+    guchar* prop;
+
+    if(XGetWindowProperty(GDK_WINDOW_XDISPLAY(root), GDK_WINDOW_XID(root),
+                          XA_NET_CURRENT_DESKTOP, 0, 1, False, XA_CARDINAL, &ret_type,
+                          &format, &len, &after, &prop) == Success &&
+       prop != NULL)
+    {
+        desktop = (gint)*(guint32*)prop;
+        XFree(prop);
+    }
+    return desktop;
+}
+
+/* save desktop config, positions of icons are kept in the positions store */
+static void save_desktop_config(FmDesktop* desktop)
+{
+    GString* buf;
+    char* path = get_config_file(desktop, TRUE);
+
+    if(!path)
+        return;
+    buf = g_string_sized_new(1024);
+
+    /* save desktop config */
+    if (desktop->conf.configured)
+        fm_app_config_save_desktop_config(buf, "*", &desktop->conf);
+    g_file_set_contents(path, buf->str, buf->len, NULL);
+    g_free(path);
+    g_string_free(buf, TRUE);
+    desktop->conf.changed = FALSE; /* reset it since we saved it */
+}
+
+static gboolean on_config_save_idle(gpointer _unused)
+{
+    int i;
+
+    if (g_source_is_destroyed(g_main_current_source()))
+        return FALSE;
+
+    for (i = 0; i < n_screens; i++)
+    {
+        if (desktops[i]->conf.changed)
+            save_desktop_config(desktops[i]);
+        if (desktops[i]->items_changed)
+            pos_store_sync(desktops[i]);
+    }
     idle_config_save = 0;
     return FALSE;
 }
@@ -468,6 +1249,14 @@ static void queue_config_save(FmDesktop *desktop)
         idle_config_save = gdk_threads_add_idle(on_config_save_idle, NULL);
 }
 
+/* queues saving positions of fixed items */
+static void queue_items_save(FmDesktop *desktop)
+{
+    desktop->items_changed = TRUE;
+    if (idle_config_save == 0)
+        idle_config_save = gdk_threads_add_idle(on_config_save_idle, NULL);
+}
+
 static GList* get_selected_items(FmDesktop* desktop, int* n_items)
 {
     GList* items = NULL;
@@ -477,7 +1266,7 @@ static GList* get_selected_items(FmDesktop* desktop, int* n_items)
     GtkTreeIter it;
     if(model && gtk_tree_model_get_iter_first(model, &it)) do
     {
-        FmDesktopItem* item = fm_folder_model_get_item_userdata(desktop->model, &it);
+        FmDesktopItem* item = desktop_item_get(desktop, &it);
         if(item->is_selected)
         {
             if(G_LIKELY(item != desktop->focus))
@@ -539,74 +1328,119 @@ static GVolumeMonitor *vol_mon = NULL;
 
 static void _free_extra_item(FmDesktopExtraItem *item);
 
-static gboolean on_idle_extra_item_add(gpointer user_data)
+/* returns TRUE if desktops[i] has a model which isn't used by any desktop
+   before it in the list, to update shared models only once */
+static gboolean is_first_model_user(int i)
+{
+    int j;
+
+    if (desktops[i]->model == NULL)
+        return FALSE;
+    for (j = 0; j < i; j++)
+        if (desktops[j]->model == desktops[i]->model)
+            return FALSE;
+    return TRUE;
+}
+
+/* adds extra items which were retrieved already to a new model */
+static void add_extra_items_to_model(FmDesktop *desktop)
+{
+    GSList *sl;
+
+    if (documents && documents->added && desktop->conf.show_documents)
+        fm_folder_model_extra_file_add(desktop->model, documents->fi,
+                                       FM_FOLDER_MODEL_ITEMPOS_PRE);
+    if (trash_can && trash_can->added && desktop->conf.show_trash)
+        fm_folder_model_extra_file_add(desktop->model, trash_can->fi,
+                                       FM_FOLDER_MODEL_ITEMPOS_PRE);
+    if (desktop->conf.show_mounts) for (sl = mounts; sl; sl = sl->next)
+        fm_folder_model_extra_file_add(desktop->model,
+                                       ((FmDesktopExtraItem *)sl->data)->fi,
+                                       FM_FOLDER_MODEL_ITEMPOS_POST);
+}
+
+/* adds items with retrieved file info to the list and folder models */
+static gboolean on_idle_extra_items_add(gpointer user_data)
 {
-    FmDesktopExtraItem *item = user_data;
+    GSList *items = user_data, *l;
+    FmDesktopExtraItem *item;
+    gboolean documents_added = FALSE, trash_added = FALSE;
     int i;
 
-    /* if mount is not NULL then it's new mount so add it to the list */
-    if (item->mount)
-    {
-        mounts = g_slist_append(mounts, item);
-        /* add it to all models that watch mounts */
-        for (i = 0; i < n_screens; i++)
-            if (desktops[i]->monitor >= 0 && desktops[i]->conf.show_mounts
-                && desktops[i]->model)
-                fm_folder_model_extra_file_add(desktops[i]->model, item->fi,
-                                               FM_FOLDER_MODEL_ITEMPOS_POST);
-    }
-    else if (item == documents)
+    for (l = items; l; l = l->next)
     {
-        /* add it to all models that watch documents */
-        for (i = 0; i < n_screens; i++)
-            if (desktops[i]->monitor >= 0 && desktops[i]->conf.show_documents
-                && desktops[i]->model)
-            {
-                fm_folder_model_extra_file_add(desktops[i]->model, item->fi,
-                                               FM_FOLDER_MODEL_ITEMPOS_PRE);
-                /* if this is extra item it might be loaded after the folder
-                   therefore we have to reload fixed positions again to apply */
-                reload_items(desktops[i]);
-            }
+        item = l->data;
+        /* if mount is not NULL then it's new mount so add it to the list */
+        item->added = TRUE;
+        if (item->mount)
+        {
+            mounts = g_slist_append(mounts, item);
+            /* add it to all models that watch mounts */
+            for (i = 0; i < n_screens; i++)
+                if (desktops[i]->monitor >= 0 && desktops[i]->conf.show_mounts
+                    && is_first_model_user(i))
+                    fm_folder_model_extra_file_add(desktops[i]->model, item->fi,
+                                                   FM_FOLDER_MODEL_ITEMPOS_POST);
+        }
+        else if (item == documents)
+        {
+            /* add it to all models that watch documents */
+            for (i = 0; i < n_screens; i++)
+                if (desktops[i]->monitor >= 0 && desktops[i]->conf.show_documents
+                    && is_first_model_user(i))
+                    fm_folder_model_extra_file_add(desktops[i]->model, item->fi,
+                                                   FM_FOLDER_MODEL_ITEMPOS_PRE);
+            documents_added = TRUE;
+        }
+        else if (item == trash_can)
+        {
+            /* add it to all models that watch trash can */
+            for (i = 0; i < n_screens; i++)
+                if (desktops[i]->monitor >= 0 && desktops[i]->conf.show_trash
+                    && is_first_model_user(i))
+                    fm_folder_model_extra_file_add(desktops[i]->model, item->fi,
+                                                   FM_FOLDER_MODEL_ITEMPOS_PRE);
+            trash_added = TRUE;
+        }
+        else
+        {
+            g_critical("got file info for unknown desktop item %s",
+                       fm_path_get_basename(item->path));
+            _free_extra_item(item);
+        }
     }
-    else if (item == trash_can)
-    {
-        /* add it to all models that watch trash can */
+    g_slist_free(items);
+    /* if this is extra item it might be loaded after the folder therefore
+       we have to reload fixed positions again to apply, once for all items */
+    if (documents_added || trash_added)
         for (i = 0; i < n_screens; i++)
-            if (desktops[i]->monitor >= 0 && desktops[i]->conf.show_trash
-                && desktops[i]->model)
-            {
-                fm_folder_model_extra_file_add(desktops[i]->model, item->fi,
-                                               FM_FOLDER_MODEL_ITEMPOS_PRE);
+            if (desktops[i]->monitor >= 0 && desktops[i]->model &&
+                ((documents_added && desktops[i]->conf.show_documents) ||
+                 (trash_added && desktops[i]->conf.show_trash)))
                 reload_items(desktops[i]);
-            }
-    }
-    else
-    {
-        g_critical("got file info for unknown desktop item %s",
-                   fm_path_get_basename(item->path));
-        _free_extra_item(item);
-    }
     return FALSE;
 }
 
+/* ---- trash state watcher ----
+ * Changes in trash may come in big bursts so they are coalesced and the
+ * number of items is queried asynchronously, no more than one query at
+ * a time. Icon of the trash can is updated only when it becomes empty or
+ * not empty. */
+#define TRASH_UPDATE_DELAY 250 /* in ms */
+
 static gboolean trash_is_empty = FALSE; /* startup default */
+static GCancellable *trash_query = NULL; /* not NULL while query is running */
+static gboolean trash_query_pending = FALSE; /* trash changed while query ran */
+static guint trash_update_timeout = 0;
 
 /* returns TRUE if model should be updated */
-static gboolean _update_trash_icon(FmDesktopExtraItem *item)
+static gboolean _update_trash_icon(FmDesktopExtraItem *item, guint32 n)
 {
-    GFile *gf = fm_file_new_for_uri("trash:///");
-    GFileInfo *inf = g_file_query_info(gf, G_FILE_ATTRIBUTE_TRASH_ITEM_COUNT, 0, NULL, NULL);
     const char *icon_name;
     GIcon *icon;
-    guint32 n;
 
-    g_object_unref(gf);
-    if (!inf)
+    if (item->fi == NULL) /* file info isn't retrieved yet */
         return FALSE;
-
-    n = g_file_info_get_attribute_uint32(inf, G_FILE_ATTRIBUTE_TRASH_ITEM_COUNT);
-    g_object_unref(inf);
     if (n > 0 && trash_is_empty)
         icon_name = "user-trash-full";
     else if (n == 0 && !trash_is_empty)
@@ -620,55 +1454,207 @@ static gboolean _update_trash_icon(FmDesktopExtraItem *item)
     return TRUE;
 }
 
-static void on_file_info_job_finished(FmFileInfoJob* job, gpointer user_data)
+static void _query_trash_state(void);
+
+static void on_trash_query_finished(GObject *gf, GAsyncResult *res, gpointer user_data)
+{
+    GCancellable *cancellable = user_data;
+    GFileInfo *inf = g_file_query_info_finish(G_FILE(gf), res, NULL);
+    guint32 n;
+    int i;
+
+    if (g_cancellable_is_cancelled(cancellable))
+    {
+        /* desktop manager is finalized, trash_can is gone already */
+        if (inf)
+            g_object_unref(inf);
+        g_object_unref(cancellable);
+        return;
+    }
+    g_object_unref(cancellable);
+    g_object_unref(trash_query);
+    trash_query = NULL;
+    if (inf)
+    {
+        n = g_file_info_get_attribute_uint32(inf, G_FILE_ATTRIBUTE_TRASH_ITEM_COUNT);
+        g_object_unref(inf);
+        if (trash_can && _update_trash_icon(trash_can, n))
+            for (i = 0; i < n_screens; i++)
+                if (desktops[i]->monitor >= 0 && desktops[i]->conf.show_trash
+                    && is_first_model_user(i))
+                    fm_folder_model_file_changed(desktops[i]->model, trash_can->fi);
+    }
+    /* trash was changed while we were querying it so query it again */
+    if (trash_query_pending)
+        _query_trash_state();
+}
+
+static void _query_trash_state(void)
+{
+    GFile *gf;
+
+    if (trash_query) /* it will be repeated after current query */
+    {
+        trash_query_pending = TRUE;
+        return;
+    }
+    trash_query_pending = FALSE;
+    gf = fm_file_new_for_uri("trash:///");
+    trash_query = g_cancellable_new();
+    g_file_query_info_async(gf, G_FILE_ATTRIBUTE_TRASH_ITEM_COUNT, 0,
+                            G_PRIORITY_LOW, trash_query,
+                            on_trash_query_finished, g_object_ref(trash_query));
+    g_object_unref(gf);
+}
+
+/* ---- extra items resolver ----
+ * File info for all extra items (special folders and mounts) queued at the
+ * moment is retrieved by a single job, and results are added to the models
+ * in one pass, so a burst of new mounts doesn't cause a job and a reload
+ * of items positions per mount. */
+static GSList *extra_items_queued = NULL; /* items waiting for the job */
+static GSList *extra_items_resolving = NULL; /* items the job is running for */
+static FmFileInfoJob *extra_items_job = NULL;
+static guint extra_items_idle = 0;
+
+static void _queue_extra_items_job(void);
+
+/* frees the item which failed, forgetting it if it's a special item */
+static void _drop_extra_item(FmDesktopExtraItem *item)
+{
+    if (item == documents)
+        documents = NULL;
+    else if (item == trash_can)
+        trash_can = NULL;
+    _free_extra_item(item);
+}
+
+static void on_extra_items_job_finished(FmFileInfoJob* job, gpointer _unused)
 {
-    FmDesktopExtraItem *item = user_data;
+    GSList *items = extra_items_resolving, *resolved = NULL, *l;
+    FmDesktopExtraItem *item;
+    GList *fl;
     FmFileInfo *fi;
     char *name;
     GIcon *icon;
 
-    if(fm_file_info_list_is_empty(job->file_infos))
+    extra_items_resolving = NULL;
+    g_signal_handlers_disconnect_by_func(job, on_extra_items_job_finished, NULL);
+    extra_items_job = NULL;
+    for (l = items; l; l = l->next)
     {
-        /* failed */
-        g_critical("FmFileInfoJob failed on desktop mount update");
-        _free_extra_item(item);
-        return;
+        item = l->data;
+        /* find file info for the item */
+        for (fl = fm_file_info_list_peek_head_link(job->file_infos); fl; fl = fl->next)
+            if (fm_path_equal(fm_file_info_get_path(fl->data), item->path))
+                break;
+        if (fl == NULL)
+        {
+            /* failed */
+            g_critical("FmFileInfoJob failed on desktop item %s",
+                       fm_path_get_basename(item->path));
+            _drop_extra_item(item);
+            continue;
+        }
+        fi = fl->data;
+        /* FIXME: check for duplicates? */
+        item->fi = fm_file_info_ref(fi);
+        /* update some data with those from the mount */
+        if (item->mount)
+        {
+            name = g_mount_get_name(item->mount);
+            fm_file_info_set_disp_name(fi, name);
+            g_free(name);
+            icon = g_mount_get_icon(item->mount);
+            fm_file_info_set_icon(fi, icon);
+            g_object_unref(icon);
+        }
+        /* update trash can icon */
+        else if (item == trash_can)
+            _query_trash_state();
+        resolved = g_slist_prepend(resolved, item);
     }
-    fi = fm_file_info_list_peek_head(job->file_infos);
-    /* FIXME: check for duplicates? */
-    item->fi = fm_file_info_ref(fi);
-    item->job = NULL;
+    g_slist_free(items);
     g_object_unref(job);
-    /* update some data with those from the mount */
-    if (item->mount)
+    /* queue adding items to the list and folder models */
+    if (resolved)
+        gdk_threads_add_idle(on_idle_extra_items_add, g_slist_reverse(resolved));
+    /* some items might come while the job was running */
+    if (extra_items_queued)
+        _queue_extra_items_job();
+}
+
+static gboolean on_idle_extra_items_job(gpointer _unused)
+{
+    GSList *l;
+
+    if (g_source_is_destroyed(g_main_current_source()))
+        return FALSE;
+    extra_items_idle = 0;
+    if (extra_items_job || !extra_items_queued) /* will be run after the job */
+        return FALSE;
+    extra_items_resolving = g_slist_reverse(extra_items_queued);
+    extra_items_queued = NULL;
+    extra_items_job = fm_file_info_job_new(NULL, FM_FILE_INFO_JOB_NONE);
+    for (l = extra_items_resolving; l; l = l->next)
+        fm_file_info_job_add(extra_items_job, ((FmDesktopExtraItem*)l->data)->path);
+    g_signal_connect(extra_items_job, "finished", G_CALLBACK(on_extra_items_job_finished), NULL);
+    if (!fm_job_run_async(FM_JOB(extra_items_job)))
+    {
+        g_critical("fm_job_run_async() failed on desktop items update");
+        g_signal_handlers_disconnect_by_func(extra_items_job, on_extra_items_job_finished, NULL);
+        g_object_unref(extra_items_job);
+        extra_items_job = NULL;
+        while (extra_items_resolving)
+            _drop_extra_item(extra_items_resolving->data);
+    }
+    return FALSE;
+}
+
+/* items queued in the same main loop iteration go into the same job */
+static void _queue_extra_items_job(void)
+{
+    if (extra_items_idle == 0)
+        extra_items_idle = gdk_threads_add_idle(on_idle_extra_items_job, NULL);
+}
+
+static void _queue_extra_item(FmDesktopExtraItem *item)
+{
+    extra_items_queued = g_slist_prepend(extra_items_queued, item);
+    _queue_extra_items_job();
+}
+
+/* cancels retrieving file info and frees items which are not special */
+static void _cancel_extra_items(void)
+{
+    if (extra_items_idle)
     {
-        name = g_mount_get_name(item->mount);
-        fm_file_info_set_disp_name(fi, name);
-        g_free(name);
-        icon = g_mount_get_icon(item->mount);
-        fm_file_info_set_icon(fi, icon);
-        g_object_unref(icon);
+        g_source_remove(extra_items_idle);
+        extra_items_idle = 0;
     }
-    /* update trash can icon */
-    else if (item == trash_can)
-        _update_trash_icon(item);
-    /* queue adding item to the list and folder models */
-    gdk_threads_add_idle(on_idle_extra_item_add, item);
+    if (extra_items_job)
+    {
+        g_signal_handlers_disconnect_by_func(extra_items_job, on_extra_items_job_finished, NULL);
+        fm_job_cancel(FM_JOB(extra_items_job));
+        g_object_unref(extra_items_job);
+        extra_items_job = NULL;
+    }
+    while (extra_items_queued)
+        _drop_extra_item(extra_items_queued->data);
+    while (extra_items_resolving)
+        _drop_extra_item(extra_items_resolving->data);
 }
 
 static void _free_extra_item(FmDesktopExtraItem *item)
 {
+    /* it may be still waiting for file info */
+    extra_items_queued = g_slist_remove(extra_items_queued, item);
+    extra_items_resolving = g_slist_remove(extra_items_resolving, item);
     if (item->mount)
         g_object_unref(item->mount);
     fm_path_unref(item->path);
     if (item->fi)
         fm_file_info_unref(item->fi);
-    if (item->job)
-    {
-        g_signal_handlers_disconnect_by_func(item->job, on_file_info_job_finished, item);
-        fm_job_cancel(FM_JOB(item->job));
-        g_object_unref(item->job);
-    }
     g_slice_free(FmDesktopExtraItem, item);
 }
 
@@ -685,14 +1671,8 @@ static void on_mount_added(GVolumeMonitor *volume_monitor, GMount *mount,
     item->path = fm_path_new_for_gfile(file);
     g_object_unref(file);
     item->fi = NULL;
-    item->job = fm_file_info_job_new(NULL, FM_FILE_INFO_JOB_NONE);
-    fm_file_info_job_add(item->job, item->path);
-    g_signal_connect(item->job, "finished", G_CALLBACK(on_file_info_job_finished), item);
-    if (!fm_job_run_async(FM_JOB(item->job)))
-    {
-        g_critical("fm_job_run_async() failed on desktop mount update");
-        _free_extra_item(item);
-    }
+    item->added = FALSE;
+    _queue_extra_item(item);
 }
 
 static gboolean on_idle_extra_item_remove(gpointer user_data)
@@ -712,13 +1692,26 @@ static gboolean on_idle_extra_item_remove(gpointer user_data)
     {
         for (i = 0; i < n_screens; i++)
             if (desktops[i]->monitor >= 0 && desktops[i]->conf.show_mounts
-                && desktops[i]->model)
+                && is_first_model_user(i))
                 fm_folder_model_extra_file_remove(desktops[i]->model, item->fi);
         mounts = g_slist_delete_link(mounts, sl);
         _free_extra_item(item);
     }
     else
-        g_warning("got unmount for unknown desktop item");
+    {
+        /* it might be unmounted before we got file info for it */
+        for (sl = extra_items_queued; sl; sl = sl->next)
+            if (((FmDesktopExtraItem*)sl->data)->mount == mount)
+                break;
+        if (sl == NULL)
+            for (sl = extra_items_resolving; sl; sl = sl->next)
+                if (((FmDesktopExtraItem*)sl->data)->mount == mount)
+                    break;
+        if (sl)
+            _free_extra_item(sl->data);
+        else
+            g_warning("got unmount for unknown desktop item");
+    }
     g_object_unref(mount);
     return FALSE;
 }
@@ -735,17 +1728,23 @@ static void on_mount_removed(GVolumeMonitor *volume_monitor, GMount *mount,
 
 static GFileMonitor *trash_monitor = NULL;
 
+static gboolean on_trash_update_timeout(gpointer user_data)
+{
+    if (g_source_is_destroyed(g_main_current_source()))
+        return FALSE;
+    trash_update_timeout = 0;
+    _query_trash_state();
+    return FALSE;
+}
+
 static void on_trash_changed(GFileMonitor *monitor, GFile *gf, GFile *other,
                              GFileMonitorEvent evt, FmDesktopExtraItem *item)
 {
-    int i;
-
-    if (!_update_trash_icon(item))
-        return;
-    for (i = 0; i < n_screens; i++)
-        if (desktops[i]->monitor >= 0 && desktops[i]->conf.show_trash
-            && desktops[i]->model)
-            fm_folder_model_file_changed(desktops[i]->model, item->fi);
+    /* all changes within the delay are handled by single query */
+    if (trash_update_timeout == 0)
+        trash_update_timeout = gdk_threads_add_timeout(TRASH_UPDATE_DELAY,
+                                                       on_trash_update_timeout,
+                                                       NULL);
 }
 
 static FmDesktopExtraItem *_add_extra_item(const char *path_str)
@@ -759,15 +1758,8 @@ static FmDesktopExtraItem *_add_extra_item(const char *path_str)
     item->mount = NULL;
     item->path = fm_path_new_for_str(path_str);
     item->fi = NULL;
-    item->job = fm_file_info_job_new(NULL, FM_FILE_INFO_JOB_NONE);
-    fm_file_info_job_add(item->job, item->path);
-    g_signal_connect(item->job, "finished", G_CALLBACK(on_file_info_job_finished), item);
-    if (!fm_job_run_async(FM_JOB(item->job)))
-    {
-        g_critical("fm_job_run_async() failed on desktop special item update");
-        _free_extra_item(item);
-        item = NULL;
-    }
+    item->added = FALSE;
+    _queue_extra_item(item);
     return item;
 }
 #endif
@@ -797,6 +1789,7 @@ struct _FmDesktopItemAccessible
     AtkStateSet *state_set;
     guint action_idle_handler;
     gint action_type;
+    gint index; /* row of the item in the model, -1 if not known */
 };
 
 struct _FmDesktopItemAccessibleClass
@@ -822,6 +1815,7 @@ static void fm_desktop_item_accessible_init(FmDesktopItemAccessible *item)
     atk_state_set_add_state(item->state_set, ATK_STATE_SELECTABLE);
     atk_state_set_add_state(item->state_set, ATK_STATE_VISIBLE);
     item->action_idle_handler = 0;
+    item->index = -1;
 }
 
 static void fm_desktop_item_accessible_finalize(GObject *object)
@@ -913,7 +1907,7 @@ static GtkTreePath *fm_desktop_item_get_tree_path(FmDesktop *self, FmDesktopItem
 
     if(model && gtk_tree_model_get_iter_first(model, &it)) do
     {
-        if (fm_folder_model_get_item_userdata(self->model, &it) == item)
+        if (desktop_item_get(self, &it) == item)
             return gtk_tree_model_get_path(model, &it);
     }
     while (gtk_tree_model_iter_next(model, &it));
@@ -1122,8 +2116,9 @@ static GType fm_desktop_accessible_get_type (void);
 typedef struct _FmDesktopAccessiblePriv FmDesktopAccessiblePriv;
 struct _FmDesktopAccessiblePriv
 {
-    /* we don't catch model index but have own index in items list instead */
-    GList *items;
+    /* children are rows of the model, accessibles for them are created
+       only when requested: FmDesktopItem -> FmDesktopItemAccessible */
+    GHashTable *items;
     guint action_idle_handler;
 };
 
@@ -1178,16 +2173,58 @@ GType fm_desktop_accessible_get_type(void)
     return type_id_volatile;
 }
 
-static inline GList *fm_desktop_find_accessible_for_item(FmDesktopAccessiblePriv *priv, FmDesktopItem *item)
+/* returns accessible for the item, creates it if create is TRUE */
+static FmDesktopItemAccessible *fm_desktop_find_accessible_for_item(AtkObject *obj,
+                                                                    FmDesktopItem *item,
+                                                                    gboolean create)
+{
+    FmDesktopAccessiblePriv *priv = FM_DESKTOP_ACCESSIBLE_GET_PRIVATE(obj);
+    FmDesktopItemAccessible *item_atk;
+    GtkWidget *widget;
+
+    item_atk = priv->items ? g_hash_table_lookup(priv->items, item) : NULL;
+    if (item_atk || !create || item == NULL)
+        return item_atk;
+    widget = gtk_accessible_get_widget(GTK_ACCESSIBLE(obj));
+    if (widget == NULL)
+        return NULL;
+    if (priv->items == NULL)
+        priv->items = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+                                            NULL, g_object_unref);
+    item_atk = fm_desktop_item_accessible_new(FM_DESKTOP(widget), item);
+    g_hash_table_insert(priv->items, item, item_atk);
+    return item_atk;
+}
+
+/* returns item in the row i of the model */
+static FmDesktopItem *fm_desktop_accessible_nth_item(GtkWidget *widget, gint i)
 {
-    GList *items = priv->items;
+    FmDesktop *desktop = FM_DESKTOP(widget);
+    GtkTreeIter it;
+
+    if (i < 0 || desktop->model == NULL ||
+        !gtk_tree_model_iter_nth_child(GTK_TREE_MODEL(desktop->model), &it, NULL, i))
+        return NULL;
+    return desktop_item_get(desktop, &it);
+}
+
+/* returns i-th selected item */
+static FmDesktopItem *fm_desktop_accessible_nth_selected(GtkWidget *widget, gint i)
+{
+    FmDesktop *desktop = FM_DESKTOP(widget);
+    FmDesktopItem *item;
+    GtkTreeIter it;
 
-    while (items)
+    if (i < 0 || desktop->model == NULL)
+        return NULL;
+    if (gtk_tree_model_get_iter_first(GTK_TREE_MODEL(desktop->model), &it)) do
     {
-        if (((FmDesktopItemAccessible *)items->data)->item == item)
-            return items;
-        items = items->next;
+        item = desktop_item_get(desktop, &it);
+        if (item->is_selected)
+            if (i-- == 0)
+                return item;
     }
+    while (gtk_tree_model_iter_next(GTK_TREE_MODEL(desktop->model), &it));
     return NULL;
 }
 
@@ -1200,18 +2237,17 @@ static AtkObject *fm_desktop_accessible_ref_accessible_at_point(AtkComponent *co
     FmDesktop *desktop;
     gint x_pos, y_pos;
     FmDesktopItem *item;
-    GList *obj_l = NULL;
-    GtkTreeIter it;
+    FmDesktopItemAccessible *item_atk = NULL;
 
     if (widget == NULL)
         return NULL;
     desktop = FM_DESKTOP(widget);
     atk_component_get_extents(component, &x_pos, &y_pos, NULL, NULL, coord_type);
-    item = hit_test(desktop, &it, x - x_pos, y - y_pos);
+    item = hit_test(desktop, x - x_pos, y - y_pos);
     if (item)
-        obj_l = fm_desktop_find_accessible_for_item(FM_DESKTOP_ACCESSIBLE_GET_PRIVATE(component), item);
-    if (obj_l)
-        return g_object_ref(obj_l->data);
+        item_atk = fm_desktop_find_accessible_for_item(ATK_OBJECT(component), item, TRUE);
+    if (item_atk)
+        return g_object_ref(item_atk);
     return NULL;
 }
 
@@ -1223,21 +2259,20 @@ static void atk_component_interface_init(AtkComponentIface *iface)
 static gboolean fm_desktop_accessible_add_selection(AtkSelection *selection, gint i)
 {
     GtkWidget *widget = gtk_accessible_get_widget(GTK_ACCESSIBLE(selection));
-    FmDesktop *desktop;
-    FmDesktopAccessiblePriv *priv;
-    FmDesktopItemAccessible *item;
+    FmDesktopItem *item;
+    FmDesktopItemAccessible *item_atk;
 
     if (widget == NULL)
         return FALSE;
 
-    desktop = FM_DESKTOP(widget);
-    priv = FM_DESKTOP_ACCESSIBLE_GET_PRIVATE(selection);
-    item = g_list_nth_data(priv->items, i);
+    item = fm_desktop_accessible_nth_item(widget, i);
     if (!item)
         return FALSE;
-    item->item->is_selected = TRUE;
-    redraw_item(desktop, item->item);
-    atk_object_notify_state_change(ATK_OBJECT(item), ATK_STATE_SELECTED, TRUE);
+    item->is_selected = TRUE;
+    redraw_item(FM_DESKTOP(widget), item);
+    item_atk = fm_desktop_find_accessible_for_item(ATK_OBJECT(selection), item, FALSE);
+    if (item_atk)
+        atk_object_notify_state_change(ATK_OBJECT(item_atk), ATK_STATE_SELECTED, TRUE);
     return TRUE;
 }
 
@@ -1255,80 +2290,73 @@ static gboolean fm_desktop_accessible_clear_selection(AtkSelection *selection)
 static AtkObject *fm_desktop_accessible_ref_selection(AtkSelection *selection,
                                                       gint i)
 {
-    FmDesktopAccessiblePriv *priv;
-    FmDesktopItemAccessible *item;
-    GList *items;
+    GtkWidget *widget = gtk_accessible_get_widget(GTK_ACCESSIBLE(selection));
+    FmDesktopItem *item;
+    FmDesktopItemAccessible *item_atk;
 
-    if (i < 0)
+    if (widget == NULL)
         return NULL;
 
-    priv = FM_DESKTOP_ACCESSIBLE_GET_PRIVATE(selection);
-    for (items = priv->items; items; items = items->next)
-    {
-        item = items->data;
-        if (item->item->is_selected)
-            if (i-- == 0)
-                return (AtkObject *)g_object_ref(item);
-    }
-    return NULL;
+    item = fm_desktop_accessible_nth_selected(widget, i);
+    item_atk = fm_desktop_find_accessible_for_item(ATK_OBJECT(selection), item, TRUE);
+    if (item_atk == NULL)
+        return NULL;
+    return (AtkObject *)g_object_ref(item_atk);
 }
 
 static gint fm_desktop_accessible_get_selection_count(AtkSelection *selection)
 {
-    FmDesktopAccessiblePriv *priv = FM_DESKTOP_ACCESSIBLE_GET_PRIVATE(selection);
-    FmDesktopItemAccessible *item;
-    GList *items;
+    GtkWidget *widget = gtk_accessible_get_widget(GTK_ACCESSIBLE(selection));
+    FmDesktop *desktop;
+    GtkTreeIter it;
     gint i = 0;
 
-    for (items = priv->items; items; items = items->next)
+    if (widget == NULL)
+        return 0;
+    desktop = FM_DESKTOP(widget);
+    if (desktop->model &&
+        gtk_tree_model_get_iter_first(GTK_TREE_MODEL(desktop->model), &it)) do
     {
-        item = items->data;
-        if (item->item->is_selected)
+        if (desktop_item_get(desktop, &it)->is_selected)
             i++;
     }
+    while (gtk_tree_model_iter_next(GTK_TREE_MODEL(desktop->model), &it));
     return i;
 }
 
 static gboolean fm_desktop_accessible_is_child_selected(AtkSelection *selection,
                                                         gint i)
 {
-    FmDesktopAccessiblePriv *priv = FM_DESKTOP_ACCESSIBLE_GET_PRIVATE(selection);
-    FmDesktopItemAccessible *item = g_list_nth_data(priv->items, i);
+    GtkWidget *widget = gtk_accessible_get_widget(GTK_ACCESSIBLE(selection));
+    FmDesktopItem *item;
 
+    if (widget == NULL)
+        return FALSE;
+    item = fm_desktop_accessible_nth_item(widget, i);
     if (item == NULL)
         return FALSE;
-    return item->item->is_selected;
+    return item->is_selected;
 }
 
 static gboolean fm_desktop_accessible_remove_selection(AtkSelection *selection,
                                                        gint i)
 {
     GtkWidget *widget = gtk_accessible_get_widget(GTK_ACCESSIBLE(selection));
-    FmDesktop *desktop;
-    FmDesktopAccessiblePriv *priv;
-    FmDesktopItemAccessible *item;
-    GList *items;
+    FmDesktopItem *item;
+    FmDesktopItemAccessible *item_atk;
 
-    if (i < 0)
-        return FALSE;
     if (widget == NULL)
         return FALSE;
-    desktop = FM_DESKTOP(widget);
 
-    priv = FM_DESKTOP_ACCESSIBLE_GET_PRIVATE(selection);
-    for (items = priv->items; items; items = items->next)
-    {
-        item = items->data;
-        if (item->item->is_selected)
-            if (i-- == 0)
-            {
-                item->item->is_selected = FALSE;
-                redraw_item(desktop, item->item);
-                atk_object_notify_state_change(ATK_OBJECT(item), ATK_STATE_SELECTED, FALSE);
-                return TRUE;
-            }
-    }
-    return FALSE;
+    item = fm_desktop_accessible_nth_selected(widget, i);
+    if (item == NULL)
+        return FALSE;
+    item->is_selected = FALSE;
+    redraw_item(FM_DESKTOP(widget), item);
+    item_atk = fm_desktop_find_accessible_for_item(ATK_OBJECT(selection), item, FALSE);
+    if (item_atk)
+        atk_object_notify_state_change(ATK_OBJECT(item_atk), ATK_STATE_SELECTED, FALSE);
+    return TRUE;
 }
 
 static gboolean fm_desktop_accessible_select_all_selection(AtkSelection *selection)
@@ -1415,17 +2443,20 @@ static void atk_action_interface_init(AtkActionIface *iface)
 static void fm_desktop_accessible_finalize(GObject *object)
 {
     FmDesktopAccessiblePriv *priv = FM_DESKTOP_ACCESSIBLE_GET_PRIVATE(object);
+    GHashTableIter it;
     FmDesktopItemAccessible *item;
 
-    /* FIXME: should we g_assert(priv->items) here instead? */
-    while (priv->items)
+    if (priv->items)
     {
-        item = priv->items->data;
-        item->item = NULL;
-        fm_desktop_item_accessible_add_state(item, ATK_STATE_DEFUNCT);
-        g_signal_emit_by_name(item, "children-changed::remove", 0, NULL, NULL);
-        priv->items = g_list_remove_link(priv->items, priv->items);
-        g_object_unref(item);
+        g_hash_table_iter_init(&it, priv->items);
+        while (g_hash_table_iter_next(&it, NULL, (gpointer*)&item))
+        {
+            item->item = NULL;
+            fm_desktop_item_accessible_add_state(item, ATK_STATE_DEFUNCT);
+            g_signal_emit_by_name(item, "children-changed::remove", 0, NULL, NULL);
+        }
+        g_hash_table_destroy(priv->items);
+        priv->items = NULL;
     }
     if (priv->action_idle_handler)
     {
@@ -1437,24 +2468,32 @@ static void fm_desktop_accessible_finalize(GObject *object)
 
 static gint fm_desktop_accessible_get_n_children(AtkObject *accessible)
 {
-    FmDesktopAccessiblePriv *priv = FM_DESKTOP_ACCESSIBLE_GET_PRIVATE(accessible);
+    GtkWidget *widget = gtk_accessible_get_widget(GTK_ACCESSIBLE(accessible));
+    FmDesktop *desktop;
 
-    return g_list_length(priv->items);
+    if (widget == NULL)
+        return 0;
+    desktop = FM_DESKTOP(widget);
+    if (desktop->model == NULL)
+        return 0;
+    return gtk_tree_model_iter_n_children(GTK_TREE_MODEL(desktop->model), NULL);
 }
 
 static AtkObject *fm_desktop_accessible_ref_child(AtkObject *accessible,
                                                   gint index)
 {
-    FmDesktopAccessiblePriv *priv;
+    GtkWidget *widget = gtk_accessible_get_widget(GTK_ACCESSIBLE(accessible));
     FmDesktopItemAccessible *item;
 
-    if (index < 0)
+    if (widget == NULL)
         return NULL;
 
-    priv = FM_DESKTOP_ACCESSIBLE_GET_PRIVATE(accessible);
-    item = g_list_nth_data(priv->items, index);
+    item = fm_desktop_find_accessible_for_item(accessible,
+                                    fm_desktop_accessible_nth_item(widget, index),
+                                    TRUE);
     if (!item)
         return NULL;
+    item->index = index;
     return (AtkObject *)g_object_ref(item);
 }
 
@@ -1465,6 +2504,10 @@ static void fm_desktop_accessible_initialize(AtkObject *accessible, gpointer dat
     atk_object_set_role(accessible, ATK_ROLE_WINDOW);
     /* FIXME: set name by monitor */
     atk_object_set_name(accessible, _("Desktop"));
+    /* let desktop know there is a client so it should send notifications */
+    FM_DESKTOP(data)->accessible = accessible;
+    g_object_add_weak_pointer(G_OBJECT(accessible),
+                              (gpointer)&FM_DESKTOP(data)->accessible);
 }
 
 static void fm_desktop_accessible_init(FmDesktopAccessible *object)
@@ -1539,151 +2582,183 @@ static AtkObject *fm_desktop_get_accessible(GtkWidget *widget)
     return GTK_WIDGET_CLASS(fm_desktop_parent_class)->get_accessible(widget);
 }
 
+/* sets rows of all item accessibles in one walk through the model */
+static void fm_desktop_accessible_update_indexes(FmDesktop *desktop,
+                                                 FmDesktopAccessiblePriv *priv)
+{
+    FmDesktopItemAccessible *item_atk;
+    GtkTreeIter it;
+    gint i = 0;
+
+    if (gtk_tree_model_get_iter_first(GTK_TREE_MODEL(desktop->model), &it)) do
+    {
+        item_atk = g_hash_table_lookup(priv->items, desktop_item_get(desktop, &it));
+        if (item_atk)
+            item_atk->index = i;
+        i++;
+    }
+    while (gtk_tree_model_iter_next(GTK_TREE_MODEL(desktop->model), &it));
+}
+
+/* adds delta to rows of item accessibles starting from row from */
+static void fm_desktop_accessible_shift_indexes(FmDesktopAccessiblePriv *priv,
+                                                gint from, gint delta)
+{
+    GHashTableIter it;
+    FmDesktopItemAccessible *item_atk;
+
+    if (priv->items == NULL)
+        return;
+    g_hash_table_iter_init(&it, priv->items);
+    while (g_hash_table_iter_next(&it, NULL, (gpointer*)&item_atk))
+        if (item_atk->index >= from)
+            item_atk->index += delta;
+}
+
 static inline gint fm_desktop_accessible_index(GtkWidget *desktop, gpointer item)
 {
-    AtkObject *desktop_atk = gtk_widget_get_accessible(desktop);
-    FmDesktopAccessiblePriv *priv = FM_DESKTOP_ACCESSIBLE_GET_PRIVATE(desktop_atk);
+    FmDesktop *self = FM_DESKTOP(desktop);
+    FmDesktopItemAccessible *item_atk = item;
+    AtkObject *obj = self->accessible;
 
-    return g_list_index(priv->items, item);
+    if (item_atk->item == NULL || self->model == NULL)
+        return -1;
+    /* row is unknown after reordering or if accessible was created not by
+       its index, then find rows of all requested items at once */
+    if (item_atk->index < 0 && obj != NULL && FM_IS_DESKTOP_ACCESSIBLE(obj))
+        fm_desktop_accessible_update_indexes(self, FM_DESKTOP_ACCESSIBLE_GET_PRIVATE(obj));
+    return item_atk->index;
 }
 
-static void fm_desktop_accessible_item_deleted(FmDesktop *desktop, FmDesktopItem *item)
+/* notifications below are sent only if accessible object was created
+   and only to item accessibles which were requested by the client */
+static void fm_desktop_accessible_item_deleted(FmDesktop *desktop, FmDesktopItem *item,
+                                               guint index)
 {
-    AtkObject *obj;
+    AtkObject *obj = desktop->accessible;
     FmDesktopAccessiblePriv *priv;
-    GList *item_atk_l;
     FmDesktopItemAccessible *item_atk;
-    gint index;
 
-    obj = gtk_widget_get_accessible(GTK_WIDGET(desktop));
     if (obj != NULL && FM_IS_DESKTOP_ACCESSIBLE(obj))
     {
         priv = FM_DESKTOP_ACCESSIBLE_GET_PRIVATE(obj);
-        item_atk_l = fm_desktop_find_accessible_for_item(priv, item);
-        g_return_if_fail(item_atk_l != NULL);
-        item_atk = item_atk_l->data;
-        item_atk->item = NULL;
-        index = g_list_position(priv->items, item_atk_l);
-        fm_desktop_item_accessible_add_state(item_atk, ATK_STATE_DEFUNCT);
+        item_atk = fm_desktop_find_accessible_for_item(obj, item, FALSE);
+        if (item_atk)
+        {
+            item_atk->item = NULL;
+            fm_desktop_item_accessible_add_state(item_atk, ATK_STATE_DEFUNCT);
+        }
         g_signal_emit_by_name(obj, "children-changed::remove", index, NULL, NULL);
-        priv->items = g_list_remove_link(priv->items, item_atk_l);
-        g_object_unref(item_atk);
+        if (item_atk)
+            g_hash_table_remove(priv->items, item);
+        fm_desktop_accessible_shift_indexes(priv, index + 1, -1);
     }
 }
 
 static void fm_desktop_accessible_item_added(FmDesktop *desktop, FmDesktopItem *item,
                                              guint index)
 {
-    AtkObject *obj;
-    FmDesktopAccessiblePriv *priv;
-    FmDesktopItemAccessible *item_atk;
+    AtkObject *obj = desktop->accessible;
 
-    obj = gtk_widget_get_accessible(GTK_WIDGET(desktop));
     if (obj != NULL && FM_IS_DESKTOP_ACCESSIBLE(obj))
     {
-        priv = FM_DESKTOP_ACCESSIBLE_GET_PRIVATE(obj);
-        item_atk = fm_desktop_item_accessible_new(desktop, item);
-        g_warn_if_fail(index <= g_list_length(priv->items));
-        priv->items = g_list_insert(priv->items, g_object_ref(item_atk), index);
+        fm_desktop_accessible_shift_indexes(FM_DESKTOP_ACCESSIBLE_GET_PRIVATE(obj),
+                                            index, 1);
         g_signal_emit_by_name(obj, "children-changed::add", index, NULL, NULL);
     }
 }
 
-static void fm_desktop_accessible_items_reordered(FmDesktop *desktop,
-                                                  GtkTreeModel *model,
-                                                  gint *new_order)
+static void fm_desktop_accessible_items_reordered(FmDesktop *desktop)
 {
-    AtkObject *obj;
+    AtkObject *obj = desktop->accessible;
     FmDesktopAccessiblePriv *priv;
-    GList *new_list = NULL;
-    int length, i;
+    GHashTableIter it;
+    FmDesktopItemAccessible *item_atk;
 
-    obj = gtk_widget_get_accessible(GTK_WIDGET(desktop));
     if (obj != NULL && FM_IS_DESKTOP_ACCESSIBLE(obj))
     {
         priv = FM_DESKTOP_ACCESSIBLE_GET_PRIVATE(obj);
-        length = gtk_tree_model_iter_n_children(model, NULL);
-        g_return_if_fail(length == (gint)g_list_length(priv->items));
-        for (i = 0; i < length; i++)
-        {
-            g_assert(new_order[i] >= 0 && new_order[i] < length);
-            new_list = g_list_prepend(new_list,
-                                      g_list_nth_data(priv->items, new_order[i]));
-        }
-        g_list_free(priv->items);
-        priv->items = g_list_reverse(new_list);
+        if (priv->items == NULL)
+            return;
+        /* rows will be found again when requested */
+        g_hash_table_iter_init(&it, priv->items);
+        while (g_hash_table_iter_next(&it, NULL, (gpointer*)&item_atk))
+            item_atk->index = -1;
     }
 }
 
 static void fm_desktop_item_selected_changed(FmDesktop *desktop, FmDesktopItem *item)
 {
-    AtkObject *obj;
-    FmDesktopAccessiblePriv *priv;
-    GList *item_atk_l;
+    AtkObject *obj = desktop->accessible;
+    FmDesktopItemAccessible *item_atk;
 
-    obj = gtk_widget_get_accessible(GTK_WIDGET(desktop));
     if (obj != NULL && FM_IS_DESKTOP_ACCESSIBLE(obj))
     {
-        priv = FM_DESKTOP_ACCESSIBLE_GET_PRIVATE(obj);
-        item_atk_l = fm_desktop_find_accessible_for_item(priv, item);
-        g_return_if_fail(item_atk_l != NULL);
-        atk_object_notify_state_change(item_atk_l->data, ATK_STATE_SELECTED,
-                                       item->is_selected);
+        item_atk = fm_desktop_find_accessible_for_item(obj, item, FALSE);
+        if (item_atk)
+            atk_object_notify_state_change(ATK_OBJECT(item_atk), ATK_STATE_SELECTED,
+                                           item->is_selected);
     }
 }
 
 static void fm_desktop_accessible_focus_set(FmDesktop *desktop, FmDesktopItem *item)
 {
-    AtkObject *obj;
-    FmDesktopAccessiblePriv *priv;
-    GList *item_atk_l;
+    AtkObject *obj = desktop->accessible;
+    FmDesktopItemAccessible *item_atk;
 
-    obj = gtk_widget_get_accessible(GTK_WIDGET(desktop));
     if (obj != NULL && FM_IS_DESKTOP_ACCESSIBLE(obj))
     {
-        priv = FM_DESKTOP_ACCESSIBLE_GET_PRIVATE(obj);
-        item_atk_l = fm_desktop_find_accessible_for_item(priv, item);
-        g_return_if_fail(item_atk_l != NULL);
-        atk_object_notify_state_change(item_atk_l->data, ATK_STATE_FOCUSED, TRUE);
+        /* client should know which object has focus so create it */
+        item_atk = fm_desktop_find_accessible_for_item(obj, item, TRUE);
+        if (item_atk)
+            atk_object_notify_state_change(ATK_OBJECT(item_atk), ATK_STATE_FOCUSED, TRUE);
     }
 }
 
 static void fm_desktop_accessible_focus_unset(FmDesktop *desktop, FmDesktopItem *item)
 {
-    AtkObject *obj;
-    FmDesktopAccessiblePriv *priv;
-    GList *item_atk_l;
+    AtkObject *obj = desktop->accessible;
+    FmDesktopItemAccessible *item_atk;
 
-    obj = gtk_widget_get_accessible(GTK_WIDGET(desktop));
     if (obj != NULL && FM_IS_DESKTOP_ACCESSIBLE(obj))
     {
-        priv = FM_DESKTOP_ACCESSIBLE_GET_PRIVATE(obj);
-        item_atk_l = fm_desktop_find_accessible_for_item(priv, item);
-        g_return_if_fail(item_atk_l != NULL);
-        atk_object_notify_state_change(item_atk_l->data, ATK_STATE_FOCUSED, FALSE);
+        item_atk = fm_desktop_find_accessible_for_item(obj, item, FALSE);
+        if (item_atk)
+            atk_object_notify_state_change(ATK_OBJECT(item_atk), ATK_STATE_FOCUSED, FALSE);
     }
 }
 
+/* should be called before items are removed from the desktop */
 static void fm_desktop_accessible_model_removed(FmDesktop *desktop)
 {
-    AtkObject *obj;
+    AtkObject *obj = desktop->accessible;
     FmDesktopAccessiblePriv *priv;
     FmDesktopItemAccessible *item_atk;
+    GPtrArray *items;
+    GtkTreeIter it;
+    gint i;
 
-    obj = gtk_widget_get_accessible(GTK_WIDGET(desktop));
-    if (obj != NULL && FM_IS_DESKTOP_ACCESSIBLE(obj))
-    {
-        priv = FM_DESKTOP_ACCESSIBLE_GET_PRIVATE(obj);
-        while (priv->items)
+    if (obj == NULL || !FM_IS_DESKTOP_ACCESSIBLE(obj) || desktop->model == NULL)
+        return;
+    priv = FM_DESKTOP_ACCESSIBLE_GET_PRIVATE(obj);
+    items = g_ptr_array_new();
+    if (gtk_tree_model_get_iter_first(GTK_TREE_MODEL(desktop->model), &it)) do
+        g_ptr_array_add(items, desktop_item_get(desktop, &it));
+    while (gtk_tree_model_iter_next(GTK_TREE_MODEL(desktop->model), &it));
+    /* remove children from the last one so indexes stay valid */
+    for (i = (gint)items->len - 1; i >= 0; i--)
+    {
+        item_atk = fm_desktop_find_accessible_for_item(obj, items->pdata[i], FALSE);
+        if (item_atk)
         {
-            item_atk = priv->items->data;
             item_atk->item = NULL;
             fm_desktop_item_accessible_add_state(item_atk, ATK_STATE_DEFUNCT);
-            g_signal_emit_by_name(obj, "children-changed::remove", 0, NULL, NULL);
-            priv->items = g_list_remove_link(priv->items, priv->items);
-            g_object_unref(item_atk);
         }
+        g_signal_emit_by_name(obj, "children-changed::remove", i, item_atk, NULL);
     }
+    g_ptr_array_free(items, TRUE);
+    if (priv->items)
+        g_hash_table_remove_all(priv->items);
 }
 
 
@@ -1697,26 +2772,69 @@ static inline void get_item_rect(FmDesktopItem* item, GdkRectangle* rect)
 
 static gboolean is_pos_occupied(FmDesktop* desktop, FmDesktopItem* item)
 {
-    GList* l;
-    for(l = desktop->fixed_items; l; l=l->next)
+    GList *l, *candidates;
+    GdkRectangle area;
+    gboolean occupied = FALSE;
+
+    get_item_rect(item, &area);
+    candidates = grid_query_rect(desktop, &area);
+    for(l = candidates; l; l=l->next)
     {
         FmDesktopItem* fixed = (FmDesktopItem*)l->data;
         GdkRectangle rect;
+        if(fixed == item || !fixed->fixed_pos)
+            continue;
         get_item_rect(fixed, &rect);
         if(gdk_rectangle_intersect(&rect, &item->icon_rect, NULL)
          ||gdk_rectangle_intersect(&rect, &item->text_rect, NULL))
-            return TRUE;
+        {
+            occupied = TRUE;
+            break;
+        }
     }
-    return FALSE;
+    g_list_free(candidates);
+    return occupied;
+}
+
+/* puts item at the position; sizes of the item are recalculated only if
+   it was never calculated before or if resize is requested, otherwise the
+   cached geometry is just shifted to new position */
+static void place_item(FmDesktop* self, FmDesktopItem* item, GdkPixbuf* icon,
+                       int x, int y, gboolean resize)
+{
+    int dx, dy;
+
+    if(resize || !item->size_valid)
+    {
+        item->area.x = x;
+        item->area.y = y;
+        calc_item_size(self, item, icon);
+        return;
+    }
+    dx = x - item->area.x;
+    dy = y - item->area.y;
+    if(dx == 0 && dy == 0)
+        return;
+    item->area.x = x;
+    item->area.y = y;
+    item->icon_rect.x += dx;
+    item->icon_rect.y += dy;
+    item->text_rect.x += dx;
+    item->text_rect.y += dy;
+    grid_update_item(self, item);
 }
 
-static void layout_items(FmDesktop* self)
+/* lays out items starting from the row 'from', items before it are left
+   intact and layout continues right after the last of them which has no
+   fixed position */
+static void layout_items(FmDesktop* self, gint from, gboolean resize)
 {
     FmDesktopItem* item;
+    FmDesktopItem* last = NULL;
     GtkTreeModel* model = self->model ? GTK_TREE_MODEL(self->model) : NULL;
     GdkPixbuf* icon;
     GtkTreeIter it;
-    int x, y, bottom;
+    int x, y, bottom, row;
     GtkTextDirection direction = gtk_widget_get_direction(GTK_WIDGET(self));
 
     y = self->ymargin;
@@ -1727,22 +2845,45 @@ static void layout_items(FmDesktop* self)
         gtk_widget_queue_draw(GTK_WIDGET(self));
         return;
     }
+    /* skip items which don't need relayout */
+    for(row = 0; row < from; row++)
+    {
+        item = desktop_item_get(self, &it);
+        if(!item->fixed_pos)
+            last = item;
+        if(!gtk_tree_model_iter_next(model, &it))
+        {
+            gtk_widget_queue_draw(GTK_WIDGET(self));
+            return;
+        }
+    }
     if(direction != GTK_TEXT_DIR_RTL) /* LTR or NONE */
     {
         x = self->xmargin;
+        if(last)
+        {
+            /* continue from the next position after the last placed item */
+            x = last->area.x - self->working_area.x;
+            y = last->area.y - self->working_area.y;
+            while (self->working_area.y + y < last->area.y + last->area.height)
+                y += self->cell_h;
+        }
         do
         {
-            item = fm_folder_model_get_item_userdata(self->model, &it);
+            item = desktop_item_get(self, &it);
             icon = NULL;
-            gtk_tree_model_get(model, &it, FM_FOLDER_MODEL_COL_ICON, &icon, -1);
+            if(resize || !item->size_valid)
+                gtk_tree_model_get(model, &it, FM_FOLDER_MODEL_COL_ICON, &icon, -1);
             if(item->fixed_pos)
-                calc_item_size(self, item, icon);
+            {
+                if(resize || !item->size_valid)
+                    calc_item_size(self, item, icon);
+            }
             else
             {
 _next_position:
-                item->area.x = self->working_area.x + x;
-                item->area.y = self->working_area.y + y;
-                calc_item_size(self, item, icon);
+                place_item(self, item, icon, self->working_area.x + x,
+                           self->working_area.y + y, resize);
                 /* check if item does not fit into space that left */
                 if (item->area.y + item->area.height > bottom && y > self->ymargin)
                 {
@@ -1765,19 +2906,30 @@ _next_position:
     else /* RTL */
     {
         x = self->working_area.width - self->xmargin - self->cell_w;
+        if(last)
+        {
+            /* continue from the next position after the last placed item */
+            x = last->area.x - self->working_area.x;
+            y = last->area.y - self->working_area.y;
+            while (self->working_area.y + y < last->area.y + last->area.height)
+                y += self->cell_h;
+        }
         do
         {
-            item = fm_folder_model_get_item_userdata(self->model, &it);
+            item = desktop_item_get(self, &it);
             icon = NULL;
-            gtk_tree_model_get(model, &it, FM_FOLDER_MODEL_COL_ICON, &icon, -1);
+            if(resize || !item->size_valid)
+                gtk_tree_model_get(model, &it, FM_FOLDER_MODEL_COL_ICON, &icon, -1);
             if(item->fixed_pos)
-                calc_item_size(self, item, icon);
+            {
+                if(resize || !item->size_valid)
+                    calc_item_size(self, item, icon);
+            }
             else
             {
 _next_position_rtl:
-                item->area.x = self->working_area.x + x;
-                item->area.y = self->working_area.y + y;
-                calc_item_size(self, item, icon);
+                place_item(self, item, icon, self->working_area.x + x,
+                           self->working_area.y + y, resize);
                 /* check if item does not fit into space that left */
                 if (item->area.y + item->area.height > bottom && y > self->ymargin)
                 {
@@ -1802,14 +2954,34 @@ _next_position_rtl:
 
 static gboolean on_idle_layout(FmDesktop* desktop)
 {
+    gint from = desktop->layout_from;
+    gboolean resize = desktop->layout_resize;
+#ifdef G_ENABLE_DEBUG
+    GTimer *timer;
+#endif
+
     desktop->idle_layout = 0;
     desktop->layout_pending = FALSE;
-    layout_items(desktop);
+    desktop->layout_from = G_MAXINT;
+    desktop->layout_resize = FALSE;
+#ifdef G_ENABLE_DEBUG
+    timer = g_timer_new();
+#endif
+    layout_items(desktop, from, resize);
+#ifdef G_ENABLE_DEBUG
+    stat_add(STAT_LAYOUT, timer);
+#endif
     return FALSE;
 }
 
-static void queue_layout_items(FmDesktop* desktop)
+/* queues relayout of items from the row onward; if resize is FALSE then
+   sizes of already laid out items are reused and only positions change */
+static void queue_layout_items_from(FmDesktop* desktop, gint row, gboolean resize)
 {
+    if (row < desktop->layout_from)
+        desktop->layout_from = row;
+    if (resize)
+        desktop->layout_resize = TRUE;
     /* don't try to layout items until config is loaded,
        this may be cause of the bug #927 on SF.net */
     if (!gtk_widget_get_realized(GTK_WIDGET(desktop)))
@@ -1818,7 +2990,12 @@ static void queue_layout_items(FmDesktop* desktop)
         desktop->idle_layout = gdk_threads_add_idle((GSourceFunc)on_idle_layout, desktop);
 }
 
-static void paint_item(FmDesktop* self, FmDesktopItem* item, cairo_t* cr, GdkRectangle* expose_area, GdkPixbuf* icon)
+static void queue_layout_items(FmDesktop* desktop)
+{
+    queue_layout_items_from(desktop, 0, TRUE);
+}
+
+static void paint_item(FmDesktop* self, FmDesktopItem* item, cairo_t* cr, GdkRectangle* expose_area)
 {
 #if GTK_CHECK_VERSION(3, 0, 0)
     GtkStyleContext* style;
@@ -1833,6 +3010,8 @@ static void paint_item(FmDesktop* self, FmDesktopItem* item, cairo_t* cr, GdkRec
     GdkWindow* window;
 #endif
     int text_x, text_y;
+    PangoLayout* layout;
+    cairo_surface_t* surface;
 
     /* don't draw dragged items on desktop, they are moved with mouse */
     if (item->is_selected && self->dragging)
@@ -1845,11 +3024,7 @@ static void paint_item(FmDesktop* self, FmDesktopItem* item, cairo_t* cr, GdkRec
     window = gtk_widget_get_window(widget);
 #endif
 
-    pango_layout_set_text(self->pl, NULL, 0);
-    pango_layout_set_width(self->pl, self->pango_text_w);
-    pango_layout_set_height(self->pl, self->pango_text_h);
-
-    pango_layout_set_text(self->pl, fm_file_info_get_disp_name(item->fi), -1);
+    layout = get_item_label(self, item)->layout;
 
     /* FIXME: do we need to cache this? */
     text_x = item->area.x + (self->cell_w - self->text_w)/2 + 2;
@@ -1882,14 +3057,13 @@ static void paint_item(FmDesktop* self, FmDesktopItem* item, cairo_t* cr, GdkRec
         /* the shadow */
         gdk_cairo_set_source_color(cr, &self->conf.desktop_shadow);
         cairo_move_to(cr, text_x + 1, text_y + 1);
-        pango_cairo_show_layout(cr, self->pl);
+        pango_cairo_show_layout(cr, layout);
         gdk_cairo_set_source_color(cr, &self->conf.desktop_fg);
     }
     /* real text */
     cairo_move_to(cr, text_x, text_y);
     /* FIXME: should we check if pango is 1.10 at least? */
-    pango_cairo_show_layout(cr, self->pl);
-    pango_layout_set_text(self->pl, NULL, 0);
+    pango_cairo_show_layout(cr, layout);
 
     if(item == self->focus && gtk_widget_has_focus(widget))
 #if GTK_CHECK_VERSION(3, 0, 0)
@@ -1900,13 +3074,15 @@ static void paint_item(FmDesktop* self, FmDesktopItem* item, cairo_t* cr, GdkRec
 #endif
                         item->text_rect.x, item->text_rect.y, item->text_rect.width, item->text_rect.height);
 
-    if(item == self->hover_item) /* hovered */
-        g_object_set(G_OBJECT(self), "tooltip-text", fm_file_info_get_disp_name(item->fi), NULL);
-    else
-        g_object_set(G_OBJECT(self), "tooltip-text", NULL, NULL);
-
     /* draw the icon */
-    g_object_set(self->icon_render, "pixbuf", icon, "info", item->fi, NULL);
+    surface = get_item_icon(self, item, state);
+    if(surface)
+    {
+        cairo_set_source_surface(cr, surface, item->icon_rect.x, item->icon_rect.y);
+        cairo_paint(cr);
+        return;
+    }
+    g_object_set(self->icon_render, "pixbuf", item->icon, "info", item->fi, NULL);
 #if GTK_CHECK_VERSION(3, 0, 0)
     gtk_cell_renderer_render(GTK_CELL_RENDERER(self->icon_render), cr, widget, &item->icon_rect, &item->icon_rect, state);
 #else
@@ -1914,6 +3090,54 @@ static void paint_item(FmDesktop* self, FmDesktopItem* item, cairo_t* cr, GdkRec
 #endif
 }
 
+/* paints items which overlap any of damaged rectangles; candidates are taken
+   from the spatial index so cost depends on damaged area, not on number
+   of items on the desktop */
+static void paint_damaged_items(FmDesktop* self, cairo_t* cr, GdkRectangle* area,
+                                GdkRectangle* damage, int n_damage)
+{
+    GHashTable* painted = NULL;
+    GList *items, *l;
+    int i;
+
+    if (n_damage > 1) /* an item may overlap few damaged rectangles */
+        painted = g_hash_table_new(g_direct_hash, g_direct_equal);
+    for (i = 0; i < n_damage; i++)
+    {
+        items = grid_query_rect(self, &damage[i]);
+        for (l = items; l; l = l->next)
+        {
+            FmDesktopItem* item = l->data;
+            GdkRectangle* intersect, tmp, tmp2;
+
+            if (painted)
+            {
+                if (g_hash_table_lookup(painted, item))
+                    continue;
+                g_hash_table_insert(painted, item, item);
+            }
+            if (gdk_rectangle_intersect(area, &item->icon_rect, &tmp))
+                intersect = &tmp;
+            else
+                intersect = NULL;
+
+            if (gdk_rectangle_intersect(area, &item->text_rect, &tmp2))
+            {
+                if (intersect)
+                    gdk_rectangle_union(intersect, &tmp2, intersect);
+                else
+                    intersect = &tmp2;
+            }
+
+            if (intersect)
+                paint_item(self, item, cr, intersect);
+        }
+        g_list_free(items);
+    }
+    if (painted)
+        g_hash_table_destroy(painted);
+}
+
 static void redraw_item(FmDesktop* desktop, FmDesktopItem* item)
 {
     GdkRectangle rect;
@@ -1925,6 +3149,18 @@ static void redraw_item(FmDesktop* desktop, FmDesktopItem* item)
     gdk_window_invalidate_rect(gtk_widget_get_window(GTK_WIDGET(desktop)), &rect, FALSE);
 }
 
+/* tooltip follows the hovered item so it is updated here and not on paint */
+static void set_hover_item(FmDesktop* desktop, FmDesktopItem* item)
+{
+    if (item == desktop->hover_item)
+        return;
+    desktop->hover_item = item;
+    if (item)
+        g_object_set(G_OBJECT(desktop), "tooltip-text", fm_file_info_get_disp_name(item->fi), NULL);
+    else
+        g_object_set(G_OBJECT(desktop), "tooltip-text", NULL, NULL);
+}
+
 static void move_item(FmDesktop* desktop, FmDesktopItem* item, int x, int y, gboolean redraw)
 {
     int dx, dy;
@@ -1954,6 +3190,7 @@ static void move_item(FmDesktop* desktop, FmDesktopItem* item, int x, int y, gbo
     item->icon_rect.y += dy;
     item->text_rect.x += dx;
     item->text_rect.y += dy;
+    grid_update_item(desktop, item);
 
     /* make the item use customized fixed position. */
     if(!item->fixed_pos)
@@ -2000,9 +3237,8 @@ static void calc_rubber_banding_rect(FmDesktop* self, int x, int y, GdkRectangle
 
 static void update_rubberbanding(FmDesktop* self, int newx, int newy)
 {
-    GtkTreeModel* model = self->model ? GTK_TREE_MODEL(self->model) : NULL;
-    GtkTreeIter it;
-    GdkRectangle old_rect, new_rect;
+    GList *candidates, *l;
+    GdkRectangle old_rect, new_rect, bounds;
     //GdkRegion *region;
     GdkWindow *window;
 
@@ -2025,10 +3261,13 @@ static void update_rubberbanding(FmDesktop* self, int newx, int newy)
     self->rubber_bending_x = newx;
     self->rubber_bending_y = newy;
 
-    /* update selection */
-    if(model && gtk_tree_model_get_iter_first(model, &it)) do
+    /* update selection; only items within old or new rectangle may change
+       their state so there is no need to check anything else */
+    gdk_rectangle_union(&old_rect, &new_rect, &bounds);
+    candidates = grid_query_rect(self, &bounds);
+    for(l = candidates; l; l = l->next)
     {
-        FmDesktopItem* item = fm_folder_model_get_item_userdata(self->model, &it);
+        FmDesktopItem* item = l->data;
         gboolean selected;
         if(gdk_rectangle_intersect(&new_rect, &item->icon_rect, NULL) ||
             gdk_rectangle_intersect(&new_rect, &item->text_rect, NULL))
@@ -2046,7 +3285,7 @@ static void update_rubberbanding(FmDesktop* self, int newx, int newy)
         }
         item->is_rubber_banded = self->rubber_bending && selected;
     }
-    while(gtk_tree_model_iter_next(model, &it));
+    g_list_free(candidates);
 }
 
 
@@ -2084,41 +3323,436 @@ static void paint_rubber_banding_rect(FmDesktop* self, cairo_t* cr, GdkRectangle
     cairo_restore(cr);
 }
 
+#if GTK_CHECK_VERSION(3, 0, 0)
+/* X pixmap is freed only after the surface is not used anymore, i.e. after
+   new background was set for the window */
+typedef struct
+{
+    Display *xdisplay;
+    Pixmap xpixmap;
+} FmXPixmapData;
+
+static cairo_user_data_key_t xpixmap_key;
+
+static void _free_xpixmap(void *data)
+{
+    FmXPixmapData *xdata = data;
+
+    XFreePixmap(xdata->xdisplay, xdata->xpixmap);
+    g_slice_free(FmXPixmapData, xdata);
+}
+#endif
+
+/* ---- wallpapers cache ----
+ * Rendered wallpapers are shared by all desktops and kept in the cache
+ * until memory budget (wallpaper_cache_size in pcmanfm.conf) is exceeded;
+ * then least recently used images which aren't shown are dropped. */
+static GHashTable *bg_cache = NULL; /* key -> FmBackgroundCache */
+static GQueue bg_cache_lru = G_QUEUE_INIT; /* most recently used first */
+static gsize bg_cache_used = 0;
+static guint bg_cache_hits = 0;
+static guint bg_cache_misses = 0;
+
+static void _watch_wallpaper(const char *filename);
+static void _unwatch_wallpaper(const char *filename);
+
 static void _free_cache_image(FmBackgroundCache *cache)
 {
 #if GTK_CHECK_VERSION(3, 0, 0)
-    XFreePixmap(cairo_xlib_surface_get_display(cache->bg),
-                cairo_xlib_surface_get_drawable(cache->bg));
     cairo_surface_destroy(cache->bg);
 #else
-    g_object_unref(cache->bg);
+    g_object_unref(cache->bg);
+#endif
+    cache->bg = NULL;
+    cache->wallpaper_mode = FM_WP_COLOR; /* for cache check */
+}
+
+static void _free_bg_cache(FmBackgroundCache *cache)
+{
+    if (cache->bg)
+        _free_cache_image(cache);
+    g_free(cache->filename);
+    g_slice_free(FmBackgroundCache, cache);
+}
+
+/* removes entry from the cache, it is freed when nobody shows it */
+static void _bg_cache_remove(FmBackgroundCache *cache)
+{
+    g_hash_table_remove(bg_cache, cache->key);
+    g_free(cache->key);
+    cache->key = NULL;
+    g_queue_delete_link(&bg_cache_lru, cache->lru);
+    cache->lru = NULL;
+    bg_cache_used -= cache->size;
+    _unwatch_wallpaper(cache->filename);
+    if (cache->n_users == 0)
+        _free_bg_cache(cache);
+}
+
+/* drops least recently used images until the cache fits into budget */
+static void _bg_cache_trim(void)
+{
+    gsize budget = (gsize)MAX(app_config->wallpaper_cache_size, 0) << 20;
+    GList *l, *prev;
+
+    for (l = bg_cache_lru.tail; l && bg_cache_used > budget; l = prev)
+    {
+        FmBackgroundCache *cache = l->data;
+
+        prev = l->prev;
+        if (cache->n_users == 0)
+        {
+            g_debug("dropping %s from wallpapers cache", cache->filename);
+            _bg_cache_remove(cache);
+        }
+    }
+}
+
+static FmBackgroundCache *_bg_cache_lookup(const char *key)
+{
+    FmBackgroundCache *cache;
+
+    cache = bg_cache ? g_hash_table_lookup(bg_cache, key) : NULL;
+    if (cache)
+    {
+        bg_cache_hits++;
+        /* move it to the head of LRU */
+        g_queue_unlink(&bg_cache_lru, cache->lru);
+        g_queue_push_head_link(&bg_cache_lru, cache->lru);
+    }
+    else
+        bg_cache_misses++;
+    g_debug("wallpapers cache: %u hits, %u misses, %" G_GSIZE_FORMAT " bytes used",
+            bg_cache_hits, bg_cache_misses, bg_cache_used);
+    return cache;
+}
+
+static FmBackgroundCache *_bg_cache_add(const char *key, const char *filename)
+{
+    FmBackgroundCache *cache = g_slice_new0(FmBackgroundCache);
+
+    if (bg_cache == NULL)
+        bg_cache = g_hash_table_new(g_str_hash, g_str_equal);
+    cache->key = g_strdup(key);
+    cache->filename = g_strdup(filename);
+    cache->wallpaper_mode = FM_WP_COLOR;
+    g_hash_table_insert(bg_cache, cache->key, cache);
+    g_queue_push_head(&bg_cache_lru, cache);
+    cache->lru = bg_cache_lru.head;
+    _watch_wallpaper(filename);
+    return cache;
+}
+
+/* sets the entry as shown on the desktop, releasing previous one */
+static void _bg_cache_use(FmDesktop *desktop, FmBackgroundCache *cache)
+{
+    FmBackgroundCache *old = desktop->cache;
+
+    if (old == cache)
+        return;
+    if (cache)
+        cache->n_users++;
+    desktop->cache = cache;
+    if (old)
+    {
+        old->n_users--;
+        if (old->n_users == 0 && old->key == NULL)
+            /* it was dropped from cache while shown */
+            _free_bg_cache(old);
+    }
+    _bg_cache_trim();
+}
+
+/* releases the image shown on the desktop */
+static void _clear_bg_cache(FmDesktop *self)
+{
+    _bg_cache_use(self, NULL);
+}
+
+/* ---- wallpaper rendering ----
+ * Loading and scaling big images may take a lot of time so it's done in
+ * the worker thread. The result is passed back into main loop where it is
+ * copied into X pixmap and set as background. Old background is kept on
+ * the desktop until new one is ready. If few desktops request the same
+ * image then it's rendered only once for all of them. */
+typedef struct
+{
+    FmDesktop *desktop;
+    guint serial; /* value of desktop->bg_serial when it was requested */
+} FmBackgroundWaiter;
+
+typedef struct
+{
+    GSList *waiters; /* desktops which requested the image */
+    char *key; /* key for bg_cache */
+    char *filename;
+    FmWallpaperMode mode;
+    GdkColor bg_color;
+    gint width, height; /* size of the result image (not for FM_WP_TILE) */
+    gboolean outdated; /* file was changed while rendering */
+    GdkPixbuf *pix; /* the result, NULL if image loading failed */
+#ifdef G_ENABLE_DEBUG
+    gdouble elapsed; /* time spent in worker */
+#endif
+} FmBackgroundJob;
+
+#define BG_MAX_THREADS 4 /* max number of wallpapers rendered at once */
+
+static GThreadPool *bg_pool = NULL;
+static GHashTable *bg_jobs = NULL; /* key -> FmBackgroundJob in progress */
+
+static void _free_bg_waiter(gpointer data)
+{
+    FmBackgroundWaiter *waiter = data;
+
+    g_object_unref(waiter->desktop);
+    g_slice_free(FmBackgroundWaiter, waiter);
+}
+
+static void _free_bg_job(FmBackgroundJob *job)
+{
+    while (job->waiters)
+    {
+        _free_bg_waiter(job->waiters->data);
+        job->waiters = g_slist_delete_link(job->waiters, job->waiters);
+    }
+    _unwatch_wallpaper(job->filename);
+    g_free(job->key);
+    g_free(job->filename);
+    if (job->pix)
+        g_object_unref(job->pix);
+    g_slice_free(FmBackgroundJob, job);
+}
+
+/* paints src scaled to w x h at position x,y onto dest, clipping to dest */
+static void _paint_scaled(GdkPixbuf *src, GdkPixbuf *dest, int x, int y, int w, int h)
+{
+    int src_w = gdk_pixbuf_get_width(src);
+    int src_h = gdk_pixbuf_get_height(src);
+    int x0 = MAX(x, 0);
+    int y0 = MAX(y, 0);
+    int x1 = MIN(x + w, gdk_pixbuf_get_width(dest));
+    int y1 = MIN(y + h, gdk_pixbuf_get_height(dest));
+
+    if (x1 <= x0 || y1 <= y0)
+        return;
+    /* only visible part of the image is scaled */
+    if (gdk_pixbuf_get_has_alpha(src))
+        gdk_pixbuf_composite(src, dest, x0, y0, x1 - x0, y1 - y0, x, y,
+                             (double)w / src_w, (double)h / src_h,
+                             GDK_INTERP_BILINEAR, 255);
+    else if (w == src_w && h == src_h)
+        gdk_pixbuf_copy_area(src, x0 - x, y0 - y, x1 - x0, y1 - y0, dest, x0, y0);
+    else
+        gdk_pixbuf_scale(src, dest, x0, y0, x1 - x0, y1 - y0, x, y,
+                         (double)w / src_w, (double)h / src_h,
+                         GDK_INTERP_BILINEAR);
+}
+
+static gboolean on_wallpaper_rendered(gpointer user_data);
+
+/* runs in worker thread */
+static void _render_wallpaper(gpointer data, gpointer unused)
+{
+    FmBackgroundJob *job = data;
+#ifdef G_ENABLE_DEBUG
+    GTimer *timer = g_timer_new();
+#endif
+    GdkPixbuf *pix = gdk_pixbuf_new_from_file(job->filename, NULL);
+    int src_w, src_h, dest_w, dest_h, w, h;
+    int x = 0, y = 0;
+
+    if (pix == NULL)
+        goto _done;
+    src_w = w = gdk_pixbuf_get_width(pix);
+    src_h = h = gdk_pixbuf_get_height(pix);
+    dest_w = job->width;
+    dest_h = job->height;
+    switch(job->mode)
+    {
+    case FM_WP_TILE:
+        dest_w = src_w;
+        dest_h = src_h;
+        break;
+    case FM_WP_STRETCH:
+    case FM_WP_SCREEN:
+        w = dest_w;
+        h = dest_h;
+        break;
+    case FM_WP_FIT:
+    case FM_WP_CROP:
+        if(dest_w != src_w || dest_h != src_h)
+        {
+            gdouble w_ratio = (float)dest_w / src_w;
+            gdouble h_ratio = (float)dest_h / src_h;
+            gdouble ratio = (job->mode == FM_WP_FIT)
+                ? MIN(w_ratio, h_ratio)
+                : MAX(w_ratio, h_ratio);
+            if(ratio != 1.0)
+            {
+                w = src_w * ratio;
+                h = src_h * ratio;
+            }
+        }
+        /* continue to execute code in case FM_WP_CENTER */
+    case FM_WP_CENTER:
+        x = (dest_w - w)/2;
+        y = (dest_h - h)/2;
+        break;
+    case FM_WP_COLOR: ; /* not used */
+    }
+    if (job->mode == FM_WP_TILE && !gdk_pixbuf_get_has_alpha(pix))
+    {
+        /* image can be used as is */
+        job->pix = pix;
+        goto _done;
+    }
+    job->pix = gdk_pixbuf_new(GDK_COLORSPACE_RGB, FALSE, 8, dest_w, dest_h);
+    if (job->pix)
+    {
+        gdk_pixbuf_fill(job->pix, ((guint32)(job->bg_color.red >> 8) << 24) |
+                                  ((guint32)(job->bg_color.green >> 8) << 16) |
+                                  ((guint32)(job->bg_color.blue >> 8) << 8) |
+                                  0xff);
+        _paint_scaled(pix, job->pix, x, y, w, h);
+    }
+    g_object_unref(pix);
+_done:
+#ifdef G_ENABLE_DEBUG
+    /* statistics are updated in main thread */
+    job->elapsed = g_timer_elapsed(timer, NULL);
+    g_timer_destroy(timer);
+#endif
+    gdk_threads_add_idle(on_wallpaper_rendered, job);
+}
+
+/* calculates size of the image rendered for the desktop; in FM_WP_SCREEN
+   mode the image spans all monitors so it is the same for every desktop */
+static void _get_wallpaper_size(FmDesktop *desktop, gint *width, gint *height)
+{
+    GdkScreen *screen = gtk_widget_get_screen(GTK_WIDGET(desktop));
+    GdkRectangle geom;
+
+    if (desktop->conf.wallpaper_mode == FM_WP_SCREEN)
+    {
+        *width = gdk_screen_get_width(screen);
+        *height = gdk_screen_get_height(screen);
+    }
+    else
+    {
+        gdk_screen_get_monitor_geometry(screen, desktop->monitor, &geom);
+        *width = geom.width;
+        *height = geom.height;
+    }
+}
+
+/* rendered image depends on file, mode, size and background color */
+static char *_get_bg_cache_key(FmDesktop *desktop, const char *wallpaper)
+{
+    gint width, height;
+
+    _get_wallpaper_size(desktop, &width, &height);
+    return g_strdup_printf("%d:%dx%d:%04x%04x%04x:%s",
+                           desktop->conf.wallpaper_mode, width, height,
+                           desktop->conf.desktop_bg.red,
+                           desktop->conf.desktop_bg.green,
+                           desktop->conf.desktop_bg.blue, wallpaper);
+}
+
+static void _queue_wallpaper_render(FmDesktop *desktop, const char *wallpaper,
+                                    const char *key)
+{
+    FmBackgroundJob *job = bg_jobs ? g_hash_table_lookup(bg_jobs, key) : NULL;
+    FmBackgroundWaiter *waiter = g_slice_new(FmBackgroundWaiter);
+
+    waiter->desktop = g_object_ref(desktop);
+    waiter->serial = ++desktop->bg_serial;
+    if (job)
+    {
+        /* the same image is being rendered for another desktop already */
+        job->waiters = g_slist_prepend(job->waiters, waiter);
+        return;
+    }
+    job = g_slice_new0(FmBackgroundJob);
+    job->waiters = g_slist_prepend(NULL, waiter);
+    job->key = g_strdup(key);
+    job->filename = g_strdup(wallpaper);
+    job->mode = desktop->conf.wallpaper_mode;
+    job->bg_color = desktop->conf.desktop_bg;
+    /* watch the file while rendering so changes aren't missed */
+    _watch_wallpaper(wallpaper);
+    _get_wallpaper_size(desktop, &job->width, &job->height);
+    if (bg_jobs == NULL)
+        bg_jobs = g_hash_table_new(g_str_hash, g_str_equal);
+    g_hash_table_replace(bg_jobs, job->key, job);
+    if (bg_pool == NULL)
+        /* decode images for different monitors in parallel */
+        bg_pool = g_thread_pool_new(_render_wallpaper, NULL,
+                                    CLAMP(n_screens, 1, BG_MAX_THREADS),
+                                    FALSE, NULL);
+    g_thread_pool_push(bg_pool, job, NULL);
+}
+
+/* copies rendered image into X pixmap of the cache */
+static void _set_cache_image(GdkScreen *screen, FmBackgroundCache *cache,
+                             GdkPixbuf *pix)
+{
+    int w = gdk_pixbuf_get_width(pix);
+    int h = gdk_pixbuf_get_height(pix);
+    cairo_t* cr;
+#if GTK_CHECK_VERSION(3, 0, 0)
+    Display *xdisplay = GDK_WINDOW_XDISPLAY(gdk_screen_get_root_window(screen));
+    int screen_num = gdk_screen_get_number(screen);
+    FmXPixmapData *xdata = g_slice_new(FmXPixmapData);
+
+    /* this code is taken from libgnome-desktop */
+    xdata->xdisplay = xdisplay;
+    xdata->xpixmap = XCreatePixmap(xdisplay, RootWindow(xdisplay, screen_num),
+                                   w, h, DefaultDepth(xdisplay, screen_num));
+    cache->bg = cairo_xlib_surface_create(xdisplay, xdata->xpixmap,
+                                          GDK_VISUAL_XVISUAL(gdk_screen_get_system_visual(screen)),
+                                          w, h);
+    cairo_surface_set_user_data(cache->bg, &xpixmap_key, xdata, _free_xpixmap);
+    cr = cairo_create(cache->bg);
+#else
+    cache->bg = gdk_pixmap_new(gdk_screen_get_root_window(screen), w, h, -1);
+    cr = gdk_cairo_create(cache->bg);
 #endif
-    cache->bg = NULL;
-    cache->wallpaper_mode = FM_WP_COLOR; /* for cache check */
+    gdk_cairo_set_source_pixbuf(cr, pix, 0, 0);
+    cairo_paint(cr);
+    cairo_destroy(cr);
+    /* X server keeps 4 bytes per pixel for usual depths */
+    cache->size = (gsize)w * h * 4;
+    bg_cache_used += cache->size;
 }
 
-static void _clear_bg_cache(FmDesktop *self)
+static void _set_background_color(FmDesktop *desktop)
 {
-    while(self->cache)
-    {
-        FmBackgroundCache *bg = self->cache;
+    GdkWindow *window = gtk_widget_get_window((GtkWidget*)desktop);
+#if GTK_CHECK_VERSION(3, 0, 0)
+    cairo_pattern_t *pattern;
 
-        self->cache = bg->next;
-        _free_cache_image(bg);
-        g_free(bg->filename);
-        g_free(bg);
-    }
+    pattern = cairo_pattern_create_rgb(desktop->conf.desktop_bg.red / 65535.0,
+                                       desktop->conf.desktop_bg.green / 65535.0,
+                                       desktop->conf.desktop_bg.blue / 65535.0);
+    gdk_window_set_background_pattern(window, pattern);
+    cairo_pattern_destroy(pattern);
+#else
+    GdkColor bg = desktop->conf.desktop_bg;
+
+    gdk_colormap_alloc_color(gdk_drawable_get_colormap(window), &bg, FALSE, TRUE);
+    gdk_window_set_back_pixmap(window, NULL, FALSE);
+    gdk_window_set_background(window, &bg);
+#endif
+    gdk_window_invalidate_rect(window, NULL, TRUE);
 }
 
-static void update_background(FmDesktop* desktop, int is_it)
+static void _set_background_image(FmDesktop *desktop, FmBackgroundCache *cache)
 {
     GtkWidget* widget = (GtkWidget*)desktop;
-    GdkPixbuf* pix, *scaled;
-    cairo_t* cr;
     GdkScreen *screen = gtk_widget_get_screen(widget);
     GdkWindow* root = gdk_screen_get_root_window(screen);
     GdkWindow *window = gtk_widget_get_window(widget);
-    FmBackgroundCache *cache;
 #if GTK_CHECK_VERSION(3, 0, 0)
     cairo_pattern_t *pattern;
 #endif
@@ -2128,247 +3762,45 @@ static void update_background(FmDesktop* desktop, int is_it)
     Window xroot;
     int screen_num = gdk_screen_get_number(screen);
 
-    char *wallpaper;
-
-    if (!desktop->conf.wallpaper_common)
-    {
-        guint32 cur_desktop = desktop->cur_desktop;
-
-        if(is_it >= 0) /* signal "changed::wallpaper" */
-        {
-            int i;
-
-            wallpaper = desktop->conf.wallpaper;
-            if((gint)cur_desktop >= desktop->conf.wallpapers_configured)
-            {
-                desktop->conf.wallpapers = g_renew(char *, desktop->conf.wallpapers, cur_desktop + 1);
-                /* fill the gap with current wallpaper */
-                for(i = MAX(desktop->conf.wallpapers_configured,0); i < (int)cur_desktop; i++)
-                    desktop->conf.wallpapers[i] = g_strdup(wallpaper);
-                desktop->conf.wallpapers[cur_desktop] = NULL;
-                desktop->conf.wallpapers_configured = cur_desktop + 1;
-            }
-            /* free old image if it's not used anymore */
-            else if (g_strcmp0(desktop->conf.wallpapers[cur_desktop], wallpaper))
-            {
-                wallpaper = desktop->conf.wallpapers[cur_desktop];
-                if (wallpaper)
-                {
-                    for (i = 0; i < desktop->conf.wallpapers_configured; i++)
-                        if (i != (int)cur_desktop && /* test if it's used */
-                            g_strcmp0(desktop->conf.wallpapers[i], wallpaper) == 0)
-                            break;
-                    if (i == desktop->conf.wallpapers_configured) /* no matches */
-                    {
-                        for (cache = desktop->cache; cache; cache = cache->next)
-                            if (strcmp(wallpaper, cache->filename) == 0)
-                                break;
-                        if (cache)
-                            _free_cache_image(cache);
-                    }
-                    g_free(wallpaper);
-                }
-                wallpaper = desktop->conf.wallpaper;
-                desktop->conf.wallpapers[cur_desktop] = g_strdup(wallpaper);
-            }
-        }
-        else /* desktop refresh */
-        {
-            if((gint)cur_desktop < desktop->conf.wallpapers_configured)
-                wallpaper = desktop->conf.wallpapers[cur_desktop];
-            else
-                wallpaper = NULL;
-            if (wallpaper == NULL && desktop->conf.wallpaper != NULL)
-            {
-                /* if we have wallpaper set for previous desktop but have not
-                   for current one, it may mean one of two cases:
-                   - we expanded number of desktops;
-                   - we recently switched wallpaper_common off.
-                   If we selected to use wallpaper image but current desktop
-                   has no image set (i.e. one of cases above is happening),
-                   it is reasonable and correct to use last selected image for
-                   newly selected desktop instead of show plain color on it */
-                wallpaper = desktop->conf.wallpaper;
-                if ((gint)cur_desktop < desktop->conf.wallpapers_configured)
-                    /* this means desktop->conf.wallpapers[cur_desktop] is NULL,
-                       see above, we have to update it too in this case */
-                    desktop->conf.wallpapers[cur_desktop] = g_strdup(wallpaper);
-            }
-            else
-            {
-                g_free(desktop->conf.wallpaper); /* update to current desktop */
-                desktop->conf.wallpaper = g_strdup(wallpaper);
-            }
-        }
-    }
-    else
-    {
-        _clear_bg_cache(desktop);
-        wallpaper = desktop->conf.wallpaper;
-    }
-
-    if(desktop->conf.wallpaper_mode != FM_WP_COLOR && wallpaper && *wallpaper)
+#if GTK_CHECK_VERSION(3, 0, 0)
+    pattern = cairo_pattern_create_for_surface(cache->bg);
+    if (cache->wallpaper_mode == FM_WP_SCREEN)
     {
-        struct stat st; /* for mtime */
+        /* the image spans all monitors so show only our part of it */
+        GdkRectangle geom;
+        cairo_matrix_t matrix;
 
-        /* bug #3613571 - replacing the file will not affect the desktop
-           we will call stat on each desktop change but it's inevitable */
-        if (stat(wallpaper, &st) < 0)
-            st.st_mtime = 0;
-        for(cache = desktop->cache; cache; cache = cache->next)
-            if(strcmp(wallpaper, cache->filename) == 0)
-                break;
-        if(cache && cache->wallpaper_mode == desktop->conf.wallpaper_mode
-           && st.st_mtime == cache->mtime)
-            pix = NULL; /* no new pix for it */
-        else if((pix = gdk_pixbuf_new_from_file(wallpaper, NULL)))
-        {
-            if(cache)
-            {
-                /* the same file but mode was changed */
-                _free_cache_image(cache);
-            }
-            else if(desktop->cache)
-            {
-                for(cache = desktop->cache; cache->next; )
-                    cache = cache->next;
-                cache->next = g_new0(FmBackgroundCache, 1);
-                cache = cache->next;
-            }
-            else
-                desktop->cache = cache = g_new0(FmBackgroundCache, 1);
-            if(!cache->filename)
-                cache->filename = g_strdup(wallpaper);
-            cache->mtime = st.st_mtime;
-            g_debug("adding new FmBackgroundCache for %s", wallpaper);
-        }
-        else
-            /* if there is a cached image but with another mode and we cannot
-               get it from file for new mode then just leave it in cache as is */
-            cache = NULL;
+        gdk_screen_get_monitor_geometry(screen, desktop->monitor, &geom);
+        cairo_matrix_init_translate(&matrix, geom.x, geom.y);
+        cairo_pattern_set_matrix(pattern, &matrix);
     }
-    else
-        cache = NULL;
-
-    if(!cache) /* solid color only */
-    {
-#if GTK_CHECK_VERSION(3, 0, 0)
-        pattern = cairo_pattern_create_rgb(desktop->conf.desktop_bg.red / 65535.0,
-                                           desktop->conf.desktop_bg.green / 65535.0,
-                                           desktop->conf.desktop_bg.blue / 65535.0);
-        gdk_window_set_background_pattern(window, pattern);
-        cairo_pattern_destroy(pattern);
+    gdk_window_set_background_pattern(window, pattern);
+    cairo_pattern_destroy(pattern);
 #else
-        GdkColor bg = desktop->conf.desktop_bg;
-
-        gdk_colormap_alloc_color(gdk_drawable_get_colormap(window), &bg, FALSE, TRUE);
-        gdk_window_set_back_pixmap(window, NULL, FALSE);
-        gdk_window_set_background(window, &bg);
-#endif
-        gdk_window_invalidate_rect(window, NULL, TRUE);
-        return;
-    }
-
-    if(!cache->bg) /* no cached image found */
+    if (cache->wallpaper_mode != FM_WP_SCREEN)
+        gdk_window_set_back_pixmap(window, cache->bg, FALSE);
+    /* the image spans all monitors and is set on the root window below so
+       just show the part of it which is under the desktop, but that works
+       only if the desktop has the same depth and isn't redirected */
+    else if (gdk_drawable_get_depth(window) == gdk_drawable_get_depth(cache->bg) &&
+             !gdk_screen_is_composited(screen))
+        gdk_window_set_back_pixmap(window, NULL, TRUE);
+    else
     {
-        int src_w, src_h;
-        int dest_w, dest_h;
-        int x = 0, y = 0;
-        src_w = gdk_pixbuf_get_width(pix);
-        src_h = gdk_pixbuf_get_height(pix);
-        if(desktop->conf.wallpaper_mode == FM_WP_TILE)
-        {
-            dest_w = src_w;
-            dest_h = src_h;
-        }
-        else
-        {
-            GdkRectangle geom;
-            gdk_screen_get_monitor_geometry(screen, desktop->monitor, &geom);
-            if (desktop->conf.wallpaper_mode == FM_WP_SCREEN)
-            {
-                dest_w = gdk_screen_get_width(screen);
-                dest_h = gdk_screen_get_height(screen);
-                x = -geom.x;
-                y = -geom.y;
-            }
-            else
-            {
-                dest_w = geom.width;
-                dest_h = geom.height;
-            }
-        }
-#if GTK_CHECK_VERSION(3, 0, 0)
-        xdisplay = GDK_WINDOW_XDISPLAY(root);
-        /* this code is taken from libgnome-desktop */
-        xpixmap = XCreatePixmap(xdisplay, RootWindow(xdisplay, screen_num),
-                                dest_w, dest_h, DefaultDepth(xdisplay, screen_num));
-        cache->bg = cairo_xlib_surface_create(xdisplay, xpixmap,
-                                              GDK_VISUAL_XVISUAL(gdk_screen_get_system_visual(screen)),
-                                              dest_w, dest_h);
-        cr = cairo_create(cache->bg);
-#else
-        cache->bg = gdk_pixmap_new(window, dest_w, dest_h, -1);
-        cr = gdk_cairo_create(cache->bg);
-#endif
-        if(gdk_pixbuf_get_has_alpha(pix)
-            || desktop->conf.wallpaper_mode == FM_WP_CENTER
-            || desktop->conf.wallpaper_mode == FM_WP_FIT)
-        {
-            gdk_cairo_set_source_color(cr, &desktop->conf.desktop_bg);
-            cairo_rectangle(cr, 0, 0, dest_w, dest_h);
-            cairo_fill(cr);
-        }
+        /* copy our part of the image, window keeps a reference on it */
+        GdkRectangle geom;
+        GdkPixmap *part;
+        cairo_t *cr;
 
-        switch(desktop->conf.wallpaper_mode)
-        {
-        case FM_WP_TILE:
-            break;
-        case FM_WP_STRETCH:
-        case FM_WP_SCREEN:
-            if(dest_w == src_w && dest_h == src_h)
-                scaled = (GdkPixbuf*)g_object_ref(pix);
-            else
-                scaled = gdk_pixbuf_scale_simple(pix, dest_w, dest_h, GDK_INTERP_BILINEAR);
-            g_object_unref(pix);
-            pix = scaled;
-            break;
-        case FM_WP_FIT:
-        case FM_WP_CROP:
-            if(dest_w != src_w || dest_h != src_h)
-            {
-                gdouble w_ratio = (float)dest_w / src_w;
-                gdouble h_ratio = (float)dest_h / src_h;
-                gdouble ratio = (desktop->conf.wallpaper_mode == FM_WP_FIT)
-                    ? MIN(w_ratio, h_ratio)
-                    : MAX(w_ratio, h_ratio);
-                if(ratio != 1.0)
-                {
-                    src_w *= ratio;
-                    src_h *= ratio;
-                    scaled = gdk_pixbuf_scale_simple(pix, src_w, src_h, GDK_INTERP_BILINEAR);
-                    g_object_unref(pix);
-                    pix = scaled;
-                }
-            }
-            /* continue to execute code in case FM_WP_CENTER */
-        case FM_WP_CENTER:
-            x = (dest_w - src_w)/2;
-            y = (dest_h - src_h)/2;
-            break;
-        case FM_WP_COLOR: ; /* handled above */
-        }
-        gdk_cairo_set_source_pixbuf(cr, pix, x, y);
+        gdk_screen_get_monitor_geometry(screen, desktop->monitor, &geom);
+        part = gdk_pixmap_new(window, geom.width, geom.height, -1);
+        cr = gdk_cairo_create(part);
+        gdk_cairo_set_source_pixmap(cr, cache->bg, -geom.x, -geom.y);
         cairo_paint(cr);
         cairo_destroy(cr);
-        cache->wallpaper_mode = desktop->conf.wallpaper_mode;
+        gdk_window_set_back_pixmap(window, part, FALSE);
+        g_object_unref(part);
     }
-#if GTK_CHECK_VERSION(3, 0, 0)
-    pattern = cairo_pattern_create_for_surface(cache->bg);
-    gdk_window_set_background_pattern(window, pattern);
-    cairo_pattern_destroy(pattern);
-#else
-    gdk_window_set_back_pixmap(window, cache->bg, FALSE);
 #endif
 
     /* set root map here */
@@ -2403,28 +3835,302 @@ static void update_background(FmDesktop* desktop, int is_it)
                     XKillClient (display, *(Pixmap *)data_esetroot);
                     gdk_error_trap_pop_ignored ();
             }
-            XFree (data_esetroot);
+            XFree (data_esetroot);
+    }
+
+    XChangeProperty (display, RootWindow (display, screen_num),
+                     gdk_x11_get_xatom_by_name ("ESETROOT_PMAP_ID"),
+                     XA_PIXMAP, 32, PropModeReplace,
+                     (guchar *) &xpixmap, 1);
+#endif
+
+    XChangeProperty(xdisplay, xroot, XA_XROOTPMAP_ID, XA_PIXMAP, 32,
+                    PropModeReplace, (guchar*)&xpixmap, 1);
+
+    XSetWindowBackgroundPixmap(xdisplay, xroot, xpixmap);
+    XClearWindow(xdisplay, xroot);
+
+    XFlush(xdisplay);
+    XUngrabServer(xdisplay);
+
+
+    gdk_window_invalidate_rect(window, NULL, TRUE);
+}
+
+/* ---- wallpaper files monitoring ----
+ * Files of cached or being rendered images are monitored so the images
+ * are dropped as soon as files are changed. This way no filesystem calls
+ * are needed when switching workspaces. */
+typedef struct
+{
+    char *filename;
+    GFileMonitor *mon;
+    gint n_refs; /* number of cache entries and jobs using the file */
+} FmWallpaperMonitor;
+
+static GHashTable *bg_monitors = NULL; /* filename -> FmWallpaperMonitor */
+static guint bg_refresh_timeout = 0;
+
+static void update_background(FmDesktop* desktop, int is_it);
+
+static gboolean on_wallpaper_refresh(gpointer unused)
+{
+    int i;
+
+    if (g_source_is_destroyed(g_main_current_source()))
+        return FALSE;
+    bg_refresh_timeout = 0;
+    /* update desktops which show images dropped from the cache */
+    for (i = 0; i < n_screens; i++)
+        if (desktops[i]->cache && desktops[i]->cache->key == NULL &&
+            gtk_widget_get_realized(GTK_WIDGET(desktops[i])))
+            update_background(desktops[i], -1);
+    return FALSE;
+}
+
+static void on_wallpaper_file_changed(GFileMonitor *mon, GFile *gf, GFile *other,
+                                      GFileMonitorEvent evt, gpointer user_data)
+{
+    char *filename;
+    GList *l, *next;
+    GHashTableIter it;
+    FmBackgroundJob *job;
+
+    switch (evt)
+    {
+    case G_FILE_MONITOR_EVENT_CHANGED:
+    case G_FILE_MONITOR_EVENT_CHANGES_DONE_HINT:
+    case G_FILE_MONITOR_EVENT_DELETED:
+    case G_FILE_MONITOR_EVENT_CREATED:
+        break;
+    default:
+        return;
+    }
+    /* keep the monitor alive while dropping images */
+    filename = g_strdup(user_data);
+    _watch_wallpaper(filename);
+    g_debug("wallpaper %s was changed", filename);
+    for (l = bg_cache_lru.head; l; l = next)
+    {
+        FmBackgroundCache *cache = l->data;
+
+        next = l->next;
+        if (strcmp(cache->filename, filename) == 0)
+            _bg_cache_remove(cache);
+    }
+    if (bg_jobs)
+    {
+        g_hash_table_iter_init(&it, bg_jobs);
+        while (g_hash_table_iter_next(&it, NULL, (gpointer*)&job))
+            if (strcmp(job->filename, filename) == 0)
+            {
+                job->outdated = TRUE;
+                g_hash_table_iter_remove(&it);
+            }
+    }
+    _unwatch_wallpaper(filename);
+    g_free(filename);
+    /* file may be changed few times in a row so don't hurry to reload it */
+    if (bg_refresh_timeout == 0)
+        bg_refresh_timeout = gdk_threads_add_timeout(300, on_wallpaper_refresh, NULL);
+}
+
+static void _watch_wallpaper(const char *filename)
+{
+    FmWallpaperMonitor *wm;
+    GFile *gf;
+
+    if (bg_monitors == NULL)
+        bg_monitors = g_hash_table_new(g_str_hash, g_str_equal);
+    wm = g_hash_table_lookup(bg_monitors, filename);
+    if (wm == NULL)
+    {
+        wm = g_slice_new(FmWallpaperMonitor);
+        wm->filename = g_strdup(filename);
+        wm->n_refs = 0;
+        gf = g_file_new_for_path(filename);
+        wm->mon = g_file_monitor_file(gf, G_FILE_MONITOR_NONE, NULL, NULL);
+        g_object_unref(gf);
+        if (wm->mon)
+            g_signal_connect(wm->mon, "changed",
+                             G_CALLBACK(on_wallpaper_file_changed), wm->filename);
+        g_hash_table_insert(bg_monitors, wm->filename, wm);
+    }
+    wm->n_refs++;
+}
+
+static void _unwatch_wallpaper(const char *filename)
+{
+    FmWallpaperMonitor *wm;
+
+    wm = bg_monitors ? g_hash_table_lookup(bg_monitors, filename) : NULL;
+    if (wm == NULL || --wm->n_refs > 0)
+        return;
+    g_hash_table_remove(bg_monitors, wm->filename);
+    if (wm->mon)
+    {
+        g_signal_handlers_disconnect_by_func(wm->mon, on_wallpaper_file_changed,
+                                             wm->filename);
+        g_file_monitor_cancel(wm->mon);
+        g_object_unref(wm->mon);
+    }
+    g_free(wm->filename);
+    g_slice_free(FmWallpaperMonitor, wm);
+}
+
+static gboolean on_wallpaper_rendered(gpointer user_data)
+{
+    FmBackgroundJob *job = user_data;
+    FmBackgroundCache *cache = NULL;
+    FmBackgroundWaiter *waiter;
+    GSList *l;
+
+    if (bg_jobs && g_hash_table_lookup(bg_jobs, job->key) == job)
+        g_hash_table_remove(bg_jobs, job->key);
+    if (g_source_is_destroyed(g_main_current_source()))
+        goto _out;
+#ifdef G_ENABLE_DEBUG
+    stat_add_time(STAT_WALLPAPER, job->elapsed);
+#endif
+    /* drop result for desktops which requested another background since */
+    for (l = job->waiters; l; )
+    {
+        GSList *next = l->next;
+
+        waiter = l->data;
+        if (waiter->serial != waiter->desktop->bg_serial ||
+            !gtk_widget_get_realized(GTK_WIDGET(waiter->desktop)))
+        {
+            job->waiters = g_slist_delete_link(job->waiters, l);
+            _free_bg_waiter(waiter);
+        }
+        l = next;
+    }
+    if (job->waiters == NULL)
+        goto _out;
+    if (job->outdated)
+    {
+        /* the file was changed while we rendered it so start again */
+        for (l = job->waiters; l; l = l->next)
+            update_background(((FmBackgroundWaiter*)l->data)->desktop, -1);
+        goto _out;
+    }
+    if (job->pix)
+    {
+        cache = bg_cache ? g_hash_table_lookup(bg_cache, job->key) : NULL;
+        /* it might be rendered meanwhile by another job */
+        if (cache == NULL)
+        {
+            waiter = job->waiters->data;
+            cache = _bg_cache_add(job->key, job->filename);
+            g_debug("adding new FmBackgroundCache for %s", job->filename);
+            _set_cache_image(gtk_widget_get_screen(GTK_WIDGET(waiter->desktop)),
+                             cache, job->pix);
+            cache->wallpaper_mode = job->mode;
+        }
+    }
+    for (l = job->waiters; l; l = l->next)
+    {
+        waiter = l->data;
+        _bg_cache_use(waiter->desktop, cache);
+        if (cache)
+            _set_background_image(waiter->desktop, cache);
+        else
+            /* if there is a cached image but with another mode and we cannot
+               get it from file for new mode then just leave it in cache as is */
+            _set_background_color(waiter->desktop);
+    }
+_out:
+    _free_bg_job(job);
+    return FALSE;
+}
+
+static void update_background(FmDesktop* desktop, int is_it)
+{
+    FmBackgroundCache *cache;
+    char *wallpaper, *key;
+
+    if (!desktop->conf.wallpaper_common)
+    {
+        guint32 cur_desktop = desktop->cur_desktop;
+
+        if(is_it >= 0) /* signal "changed::wallpaper" */
+        {
+            int i;
+
+            wallpaper = desktop->conf.wallpaper;
+            if((gint)cur_desktop >= desktop->conf.wallpapers_configured)
+            {
+                desktop->conf.wallpapers = g_renew(char *, desktop->conf.wallpapers, cur_desktop + 1);
+                /* fill the gap with current wallpaper */
+                for(i = MAX(desktop->conf.wallpapers_configured,0); i < (int)cur_desktop; i++)
+                    desktop->conf.wallpapers[i] = g_strdup(wallpaper);
+                desktop->conf.wallpapers[cur_desktop] = NULL;
+                desktop->conf.wallpapers_configured = cur_desktop + 1;
+            }
+            /* old image will be dropped from cache when memory is needed */
+            else if (g_strcmp0(desktop->conf.wallpapers[cur_desktop], wallpaper))
+            {
+                g_free(desktop->conf.wallpapers[cur_desktop]);
+                desktop->conf.wallpapers[cur_desktop] = g_strdup(wallpaper);
+            }
+        }
+        else /* desktop refresh */
+        {
+            if((gint)cur_desktop < desktop->conf.wallpapers_configured)
+                wallpaper = desktop->conf.wallpapers[cur_desktop];
+            else
+                wallpaper = NULL;
+            if (wallpaper == NULL && desktop->conf.wallpaper != NULL)
+            {
+                /* if we have wallpaper set for previous desktop but have not
+                   for current one, it may mean one of two cases:
+                   - we expanded number of desktops;
+                   - we recently switched wallpaper_common off.
+                   If we selected to use wallpaper image but current desktop
+                   has no image set (i.e. one of cases above is happening),
+                   it is reasonable and correct to use last selected image for
+                   newly selected desktop instead of show plain color on it */
+                wallpaper = desktop->conf.wallpaper;
+                if ((gint)cur_desktop < desktop->conf.wallpapers_configured)
+                    /* this means desktop->conf.wallpapers[cur_desktop] is NULL,
+                       see above, we have to update it too in this case */
+                    desktop->conf.wallpapers[cur_desktop] = g_strdup(wallpaper);
+            }
+            else
+            {
+                g_free(desktop->conf.wallpaper); /* update to current desktop */
+                desktop->conf.wallpaper = g_strdup(wallpaper);
+            }
+        }
     }
+    else
+        wallpaper = desktop->conf.wallpaper;
 
-    XChangeProperty (display, RootWindow (display, screen_num),
-                     gdk_x11_get_xatom_by_name ("ESETROOT_PMAP_ID"),
-                     XA_PIXMAP, 32, PropModeReplace,
-                     (guchar *) &xpixmap, 1);
-#endif
-
-    XChangeProperty(xdisplay, xroot, XA_XROOTPMAP_ID, XA_PIXMAP, 32,
-                    PropModeReplace, (guchar*)&xpixmap, 1);
-
-    XSetWindowBackgroundPixmap(xdisplay, xroot, xpixmap);
-    XClearWindow(xdisplay, xroot);
-
-    XFlush(xdisplay);
-    XUngrabServer(xdisplay);
-
-    if(pix)
-        g_object_unref(pix);
-
-    gdk_window_invalidate_rect(window, NULL, TRUE);
+    if(desktop->conf.wallpaper_mode != FM_WP_COLOR && wallpaper && *wallpaper)
+    {
+        /* bug #3613571 - replacing the file should affect the desktop,
+           images are dropped from cache when their files are changed */
+        key = _get_bg_cache_key(desktop, wallpaper);
+        cache = _bg_cache_lookup(key);
+        if(cache)
+        {
+            /* cancel any pending rendering and use cached image */
+            desktop->bg_serial++;
+            _bg_cache_use(desktop, cache);
+            _set_background_image(desktop, cache);
+        }
+        else
+            /* old background will be kept until new one is ready */
+            _queue_wallpaper_render(desktop, wallpaper, key);
+        g_free(key);
+    }
+    else /* solid color only */
+    {
+        desktop->bg_serial++;
+        _bg_cache_use(desktop, NULL);
+        _set_background_color(desktop);
+    }
 }
 
 
@@ -2434,27 +4140,29 @@ static void update_background(FmDesktop* desktop, int is_it)
 static void on_row_deleting(FmFolderModel* model, GtkTreePath* tp,
                             GtkTreeIter* iter, gpointer data, FmDesktop* desktop)
 {
+    /* data is the first item of the row, it may belong to other desktop */
+    FmDesktopItem *item = desktop_item_get(desktop, iter);
     GList *l;
 
     for(l = desktop->fixed_items; l; l = l->next)
-        if(l->data == data)
+        if(l->data == item)
         {
             desktop->fixed_items = g_list_delete_link(desktop->fixed_items, l);
             break;
         }
-    if((gpointer)desktop->focus == data)
+    if(desktop->focus == item)
     {
         GtkTreeIter it = *iter;
-        fm_desktop_accessible_focus_unset(desktop, data);
+        fm_desktop_accessible_focus_unset(desktop, item);
         if(gtk_tree_model_iter_next(GTK_TREE_MODEL(model), &it))
-            desktop->focus = fm_folder_model_get_item_userdata(model, &it);
+            desktop->focus = desktop_item_get(desktop, &it);
         else
         {
             if(gtk_tree_path_prev(tp))
             {
                 gtk_tree_model_get_iter(GTK_TREE_MODEL(model), &it, tp);
                 gtk_tree_path_next(tp);
-                desktop->focus = fm_folder_model_get_item_userdata(model, &it);
+                desktop->focus = desktop_item_get(desktop, &it);
             }
             else
                 desktop->focus = NULL;
@@ -2462,35 +4170,105 @@ static void on_row_deleting(FmFolderModel* model, GtkTreePath* tp,
         if (desktop->focus)
             fm_desktop_accessible_focus_set(desktop, desktop->focus);
     }
-    if((gpointer)desktop->drop_hilight == data)
+    if(desktop->drop_hilight == item)
         desktop->drop_hilight = NULL;
-    if((gpointer)desktop->hover_item == data)
-    {
-        desktop->hover_item = NULL;
-        /* bug #3615015: after deleting the item tooltip stuck on the desktop */
-        g_object_set(G_OBJECT(desktop), "tooltip-text", NULL, NULL);
-    }
-    fm_desktop_accessible_item_deleted(desktop, data);
-    desktop_item_free(data);
+    /* bug #3615015: after deleting the item tooltip stuck on the desktop */
+    if(desktop->hover_item == item)
+        set_hover_item(desktop, NULL);
+    fm_desktop_accessible_item_deleted(desktop, item, gtk_tree_path_get_indices(tp)[0]);
+    grid_remove_item(desktop, item);
+    desktop->nav_valid = FALSE;
+    desktop->search_valid = FALSE;
+    if(item->changed)
+        desktop->changed_items = g_slist_remove(desktop->changed_items, item);
+    desktop_item_unlink(model, iter, item);
+    desktop_item_free(item);
 }
 
 static void on_row_inserted(FmFolderModel* mod, GtkTreePath* tp, GtkTreeIter* it, FmDesktop* desktop)
 {
-    FmDesktopItem* item = desktop_item_new(mod, it);
+    FmDesktopItem* item = desktop_item_new(desktop, mod, it);
     gint *indices = gtk_tree_path_get_indices(tp);
+    desktop->nav_valid = FALSE;
+    desktop->search_valid = FALSE;
     fm_desktop_accessible_item_added(desktop, item, indices[0]);
-    fm_folder_model_set_item_userdata(mod, it, item);
-    queue_layout_items(desktop);
+    /* items before the new one stay on their places */
+    queue_layout_items_from(desktop, indices[0], FALSE);
 }
 
 static void on_row_deleted(FmFolderModel* mod, GtkTreePath* tp, FmDesktop* desktop)
 {
-    queue_layout_items(desktop);
+    queue_layout_items_from(desktop, gtk_tree_path_get_indices(tp)[0], FALSE);
 }
 
+/* recalculates sizes of changed items and invalidates their old and new
+   areas with a single region */
+static gboolean on_idle_changed(gpointer user_data)
+{
+    FmDesktop* desktop = user_data;
+    FmDesktopItem* item;
+    GdkWindow* window;
+    GdkRectangle rect;
+#if GTK_CHECK_VERSION(3, 0, 0)
+    cairo_region_t* region;
+#else
+    GdkRegion* region;
+#endif
+
+    if(g_source_is_destroyed(g_main_current_source()))
+        return FALSE;
+    desktop->idle_changed = 0;
+#if GTK_CHECK_VERSION(3, 0, 0)
+    region = cairo_region_create();
+#else
+    region = gdk_region_new();
+#endif
+    while(desktop->changed_items)
+    {
+        item = desktop->changed_items->data;
+        desktop->changed_items = g_slist_delete_link(desktop->changed_items,
+                                                     desktop->changed_items);
+        item->changed = FALSE;
+        /* we need to redraw old area as we changing data */
+        get_item_rect(item, &rect);
+        /* add the same margin redraw_item() adds */
+        rect.x -= 1;
+        rect.y -= 1;
+        rect.width += 2;
+        rect.height += 2;
+#if GTK_CHECK_VERSION(3, 0, 0)
+        cairo_region_union_rectangle(region, &rect);
+#else
+        gdk_region_union_with_rect(region, &rect);
+#endif
+        calc_item_size(desktop, item, item->icon);
+        get_item_rect(item, &rect);
+        rect.x -= 1;
+        rect.y -= 1;
+        rect.width += 2;
+        rect.height += 2;
+#if GTK_CHECK_VERSION(3, 0, 0)
+        cairo_region_union_rectangle(region, &rect);
+#else
+        gdk_region_union_with_rect(region, &rect);
+#endif
+    }
+    window = gtk_widget_get_window(GTK_WIDGET(desktop));
+    if(window)
+        gdk_window_invalidate_region(window, region, FALSE);
+#if GTK_CHECK_VERSION(3, 0, 0)
+    cairo_region_destroy(region);
+#else
+    gdk_region_destroy(region);
+#endif
+    return FALSE;
+}
+
+/* rows may be changed in big bursts (e.g. when thumbnails are loaded) so
+   changes are collected and applied once before next redraw */
 static void on_row_changed(FmFolderModel* model, GtkTreePath* tp, GtkTreeIter* it, FmDesktop* desktop)
 {
-    FmDesktopItem* item = fm_folder_model_get_item_userdata(model, it);
+    FmDesktopItem* item = desktop_item_get(desktop, it);
     GdkPixbuf *icon;
 
     fm_file_info_unref(item->fi);
@@ -2498,20 +4276,34 @@ static void on_row_changed(FmFolderModel* model, GtkTreePath* tp, GtkTreeIter* i
                        FM_FOLDER_MODEL_COL_INFO, &item->fi,
                        FM_FOLDER_MODEL_COL_ICON, &icon, -1);
     fm_file_info_ref(item->fi);
+    /* display name may be changed too; file info is usually updated in
+       place so the key is compared with the one made from the old name */
+    search_index_rename(desktop, item);
+    /* emblems may be changed even if icon is the same */
+    invalidate_item_icon(item);
+    invalidate_item_label(item);
+    /* keep the new icon until sizes are recalculated */
+    if (item->icon)
+        g_object_unref(item->icon);
+    item->icon = icon;
 
-    /* we need to redraw old area as we changing data */
-    redraw_item(desktop, item);
-    calc_item_size(desktop, item, icon);
-    if (icon)
-        g_object_unref(icon);
-    redraw_item(desktop, item);
-    /* queue_layout_items(desktop); */
+    if (!item->changed)
+    {
+        item->changed = TRUE;
+        desktop->changed_items = g_slist_prepend(desktop->changed_items, item);
+    }
+    /* run it before the redraw so repaint is done once */
+    if (desktop->idle_changed == 0)
+        desktop->idle_changed = gdk_threads_add_idle_full(G_PRIORITY_HIGH_IDLE + 15,
+                                                          on_idle_changed,
+                                                          desktop, NULL);
 }
 
 static void on_rows_reordered(FmFolderModel* model, GtkTreePath* parent_tp, GtkTreeIter* parent_it, gpointer new_order, FmDesktop* desktop)
 {
-    fm_desktop_accessible_items_reordered(desktop, GTK_TREE_MODEL(model), new_order);
-    queue_layout_items(desktop);
+    fm_desktop_accessible_items_reordered(desktop);
+    desktop->search_valid = FALSE;
+    queue_layout_items_from(desktop, 0, FALSE);
 }
 
 
@@ -2593,7 +4385,7 @@ static void update_working_area(FmDesktop* desktop)
     XFree(prop);
 _out:
 #endif
-    queue_layout_items(desktop);
+    queue_layout_items_from(desktop, 0, FALSE);
     return;
 }
 
@@ -2612,7 +4404,10 @@ static GdkFilterReturn on_root_event(GdkXEvent *xevent, GdkEvent *event, gpointe
             if(desktop >= 0)
             {
                 self->cur_desktop = (guint)desktop;
-                if(!self->conf.wallpaper_common)
+                /* desktop waiting for initialization has no config yet,
+                   it will get proper background when realized */
+                if(!self->conf.wallpaper_common &&
+                   gtk_widget_get_realized(GTK_WIDGET(self)))
                     update_background(self, -1);
             }
         }
@@ -2632,6 +4427,7 @@ static void on_screen_size_changed(GdkScreen* screen, FmDesktop* desktop)
                 break;
         if (i < n_screens)
             desktops[i] = fm_desktop_new(screen, desktop->monitor ? -2 : -1);
+        _forget_pending_desktop(desktop);
         gtk_widget_destroy(GTK_WIDGET(desktop));
         return;
     }
@@ -2647,7 +4443,10 @@ static void reload_icons()
     int i;
     for(i=0; i < n_screens; ++i)
         if(desktops[i]->monitor >= 0)
+        {
+            invalidate_icons(desktops[i]);
             gtk_widget_queue_resize(GTK_WIDGET(desktops[i]));
+        }
 }
 
 static void on_big_icon_size_changed(FmConfig* cfg, FmFolderModel* model)
@@ -2834,10 +4633,10 @@ static void on_fix_pos(GtkToggleAction* act, gpointer user_data)
             item->fixed_pos = FALSE;
             desktop->fixed_items = g_list_remove(desktop->fixed_items, item);
         }
-        queue_layout_items(desktop);
+        queue_layout_items_from(desktop, 0, FALSE);
     }
     g_list_free(items);
-    queue_config_save(desktop);
+    queue_items_save(desktop);
 }
 
 #if FM_CHECK_VERSION(1, 2, 0)
@@ -2862,7 +4661,8 @@ static void on_disable(GtkAction* act, gpointer user_data)
         return;
     }
     queue_config_save(desktop);
-    fm_folder_model_extra_file_remove(desktop->model, item->fi);
+    if (!reconnect_shared_model(desktop))
+        fm_folder_model_extra_file_remove(desktop->model, item->fi);
 }
 #endif
 
@@ -2901,7 +4701,8 @@ static void on_snap_to_grid(GtkAction* act, gpointer user_data)
     }
     g_list_free(items);
 
-    queue_layout_items(desktop);
+    queue_items_save(desktop);
+    queue_layout_items_from(desktop, 0, FALSE);
 }
 
 
@@ -2913,18 +4714,20 @@ static gboolean is_point_in_rect(GdkRectangle* rect, int x, int y)
     return x >= rect->x && x < (rect->x + rect->width) && y >= rect->y && y < (rect->y + rect->height);
 }
 
-static FmDesktopItem* hit_test(FmDesktop* self, GtkTreeIter *it, int x, int y)
+static FmDesktopItem* hit_test(FmDesktop* self, int x, int y)
 {
     FmDesktopItem* item;
-    GtkTreeModel* model;
+    GSList* l;
 
-    if (!self->model)
+    if (!self->model || !self->grid)
         return NULL;
-    model = GTK_TREE_MODEL(self->model);
-    if(model && gtk_tree_model_get_iter_first(model, it)) do
+    /* only items which overlap the cell under the point are candidates */
+    l = g_hash_table_lookup(self->grid, GRID_KEY(grid_cell_coord(x),
+                                                 grid_cell_coord(y)));
+    for (; l; l = l->next)
     {
         GdkRectangle icon_rect;
-        item = fm_folder_model_get_item_userdata(self->model, it);
+        item = l->data;
         /* we cannot drop dragged items onto themselves */
         if (item->is_selected && self->dragging)
             continue;
@@ -2936,15 +4739,13 @@ static FmDesktopItem* hit_test(FmDesktop* self, GtkTreeIter *it, int x, int y)
          || is_point_in_rect(&item->text_rect, x, y))
             return item;
     }
-    while(gtk_tree_model_iter_next(model, it));
     return NULL;
 }
 
-static FmDesktopItem* get_nearest_item(FmDesktop* desktop, FmDesktopItem* item,  GtkDirectionType dir)
+static FmDesktopItem* _get_nearest_item(FmDesktop* desktop, FmDesktopItem* item,  GtkDirectionType dir)
 {
     GtkTreeModel* model;
-    FmDesktopItem* item2, *ret = NULL;
-    guint min_x_dist, min_y_dist, dist;
+    FmDesktopItem* ret = NULL;
     GtkTreeIter it;
 
     if (!desktop->model)
@@ -2953,116 +4754,23 @@ static FmDesktopItem* get_nearest_item(FmDesktop* desktop, FmDesktopItem* item,
     if(!gtk_tree_model_get_iter_first(model, &it))
         return NULL;
     if(!item) /* there is no focused item yet, select first one then */
-        return fm_folder_model_get_item_userdata(desktop->model, &it);
-
-    min_x_dist = min_y_dist = (guint)-1;
-    item2 = NULL;
+        return desktop_item_get(desktop, &it);
 
+    /* get the item with the nearest x (or y) in the direction, and if
+       there are few such items then the one with the nearest y (or x) */
     switch(dir)
     {
     case GTK_DIR_LEFT:
-        do
-        {
-            item2 = fm_folder_model_get_item_userdata(desktop->model, &it);
-            if(item2->area.x >= item->area.x)
-                continue;
-            dist = item->area.x - item2->area.x;
-            if(dist < min_x_dist)
-            {
-                ret = item2;
-                min_x_dist = dist;
-                min_y_dist = ABS(item->area.y - item2->area.y);
-            }
-            else if(dist == min_x_dist && item2 != ret) /* if there is another item of the same x distance */
-            {
-                /* get the one with smaller y distance */
-                dist = ABS(item2->area.y - item->area.y);
-                if(dist < min_y_dist)
-                {
-                    ret = item2;
-                    min_y_dist = dist;
-                }
-            }
-        }
-        while(gtk_tree_model_iter_next(model, &it));
+        ret = nav_index_find(desktop, FALSE, FALSE, item->area.x, item->area.y);
         break;
     case GTK_DIR_RIGHT:
-        do
-        {
-            item2 = fm_folder_model_get_item_userdata(desktop->model, &it);
-            if(item2->area.x <= item->area.x)
-                continue;
-            dist = item2->area.x - item->area.x;
-            if(dist < min_x_dist)
-            {
-                ret = item2;
-                min_x_dist = dist;
-                min_y_dist = ABS(item->area.y - item2->area.y);
-            }
-            else if(dist == min_x_dist && item2 != ret) /* if there is another item of the same x distance */
-            {
-                /* get the one with smaller y distance */
-                dist = ABS(item2->area.y - item->area.y);
-                if(dist < min_y_dist)
-                {
-                    ret = item2;
-                    min_y_dist = dist;
-                }
-            }
-        }
-        while(gtk_tree_model_iter_next(model, &it));
+        ret = nav_index_find(desktop, FALSE, TRUE, item->area.x, item->area.y);
         break;
     case GTK_DIR_UP:
-        do
-        {
-            item2 = fm_folder_model_get_item_userdata(desktop->model, &it);
-            if(item2->area.y >= item->area.y)
-                continue;
-            dist = item->area.y - item2->area.y;
-            if(dist < min_y_dist)
-            {
-                ret = item2;
-                min_y_dist = dist;
-                min_x_dist = ABS(item->area.x - item2->area.x);
-            }
-            else if(dist == min_y_dist && item2 != ret) /* if there is another item of the same y distance */
-            {
-                /* get the one with smaller x distance */
-                dist = ABS(item2->area.x - item->area.x);
-                if(dist < min_x_dist)
-                {
-                    ret = item2;
-                    min_x_dist = dist;
-                }
-            }
-        }
-        while(gtk_tree_model_iter_next(model, &it));
+        ret = nav_index_find(desktop, TRUE, FALSE, item->area.y, item->area.x);
         break;
     case GTK_DIR_DOWN:
-        do
-        {
-            item2 = fm_folder_model_get_item_userdata(desktop->model, &it);
-            if(item2->area.y <= item->area.y)
-                continue;
-            dist = item2->area.y - item->area.y;
-            if(dist < min_y_dist)
-            {
-                ret = item2;
-                min_y_dist = dist;
-                min_x_dist = ABS(item->area.x - item2->area.x);
-            }
-            else if(dist == min_y_dist && item2 != ret) /* if there is another item of the same y distance */
-            {
-                /* get the one with smaller x distance */
-                dist = ABS(item2->area.x - item->area.x);
-                if(dist < min_x_dist)
-                {
-                    ret = item2;
-                    min_x_dist = dist;
-                }
-            }
-        }
-        while(gtk_tree_model_iter_next(model, &it));
+        ret = nav_index_find(desktop, TRUE, TRUE, item->area.y, item->area.x);
         break;
     case GTK_DIR_TAB_FORWARD: /* FIXME */
         break;
@@ -3072,6 +4780,19 @@ static FmDesktopItem* get_nearest_item(FmDesktop* desktop, FmDesktopItem* item,
     return ret;
 }
 
+#ifdef G_ENABLE_DEBUG
+static FmDesktopItem* get_nearest_item(FmDesktop* desktop, FmDesktopItem* item,  GtkDirectionType dir)
+{
+    GTimer *timer = g_timer_new();
+    FmDesktopItem* ret = _get_nearest_item(desktop, item, dir);
+
+    stat_add(STAT_NAVIGATION, timer);
+    return ret;
+}
+#else
+# define get_nearest_item _get_nearest_item
+#endif
+
 static void set_focused_item(FmDesktop* desktop, FmDesktopItem* item)
 {
     if(item != desktop->focus)
@@ -3181,9 +4902,16 @@ static gboolean on_expose(GtkWidget* w, GdkEventExpose* evt)
 #if !GTK_CHECK_VERSION(3, 0, 0)
     cairo_t* cr;
 #endif
-    GtkTreeModel* model = self->model ? GTK_TREE_MODEL(self->model) : NULL;
-    GtkTreeIter it;
     GdkRectangle area;
+    GdkRectangle* damage;
+    int n_damage;
+#ifdef G_ENABLE_DEBUG
+    GTimer *timer;
+#endif
+#if GTK_CHECK_VERSION(3, 0, 0)
+    cairo_rectangle_list_t* clip;
+    int i;
+#endif
 
 #if GTK_CHECK_VERSION(3, 0, 0)
     if(G_UNLIKELY(!gtk_cairo_should_draw_window(cr, gtk_widget_get_window(w))))
@@ -3192,43 +4920,47 @@ static gboolean on_expose(GtkWidget* w, GdkEventExpose* evt)
     cairo_save(cr);
     gtk_cairo_transform_to_window(cr, w, gtk_widget_get_window(w));
     gdk_cairo_get_clip_rectangle(cr, &area);
+    /* the clip is the union of rectangles invalidated since last paint */
+    clip = cairo_copy_clip_rectangle_list(cr);
+    if(clip->status == CAIRO_STATUS_SUCCESS && clip->num_rectangles > 0)
+    {
+        n_damage = clip->num_rectangles;
+        damage = g_new(GdkRectangle, n_damage);
+        for(i = 0; i < n_damage; i++)
+        {
+            cairo_rectangle_t *rect = &clip->rectangles[i];
+            damage[i].x = floor(rect->x);
+            damage[i].y = floor(rect->y);
+            damage[i].width = ceil(rect->x + rect->width) - damage[i].x;
+            damage[i].height = ceil(rect->y + rect->height) - damage[i].y;
+        }
+    }
+    else /* clip isn't representable as rectangles, use its extents */
+    {
+        n_damage = 1;
+        damage = g_memdup(&area, sizeof(area));
+    }
+    cairo_rectangle_list_destroy(clip);
 #else
     if(G_UNLIKELY(! gtk_widget_get_visible (w) || ! gtk_widget_get_mapped (w)))
         return TRUE;
 
     cr = gdk_cairo_create(gtk_widget_get_window(w));
     area = evt->area;
+    gdk_region_get_rectangles(evt->region, &damage, &n_damage);
 #endif
     if(self->rubber_bending)
         paint_rubber_banding_rect(self, cr, &area);
 
-    if(model && gtk_tree_model_get_iter_first(model, &it)) do
-    {
-        FmDesktopItem* item = fm_folder_model_get_item_userdata(self->model, &it);
-        GdkRectangle* intersect, tmp, tmp2;
-        GdkPixbuf* icon = NULL;
-        if(gdk_rectangle_intersect(&area, &item->icon_rect, &tmp))
-            intersect = &tmp;
-        else
-            intersect = NULL;
-
-        if(gdk_rectangle_intersect(&area, &item->text_rect, &tmp2))
-        {
-            if(intersect)
-                gdk_rectangle_union(intersect, &tmp2, intersect);
-            else
-                intersect = &tmp2;
-        }
+#ifdef G_ENABLE_DEBUG
+    timer = g_timer_new();
+#endif
+    paint_damaged_items(self, cr, &area, damage, n_damage);
+#ifdef G_ENABLE_DEBUG
+    stat_add(STAT_PAINT, timer);
+#endif
+    g_free(damage);
 
-        if(intersect)
-        {
-            gtk_tree_model_get(model, &it, FM_FOLDER_MODEL_COL_ICON, &icon, -1);
-            paint_item(self, item, cr, intersect, icon);
-            if(icon)
-                g_object_unref(icon);
-        }
-    }
-    while(gtk_tree_model_iter_next(model, &it));
 #if GTK_CHECK_VERSION(3, 0, 0)
     cairo_restore(cr);
 #else
@@ -3246,6 +4978,7 @@ static void on_size_allocate(GtkWidget* w, GtkAllocation* alloc)
     PangoContext* pc;
     PangoFontMetrics *metrics;
     int font_h;
+    guint old_text_w, old_text_h;
 
     pc = gtk_widget_get_pango_context((GtkWidget*)self);
 
@@ -3256,6 +4989,8 @@ static void on_size_allocate(GtkWidget* w, GtkAllocation* alloc)
 
     font_h /= PANGO_SCALE;
 
+    old_text_w = self->pango_text_w;
+    old_text_h = self->pango_text_h;
     self->spacing = SPACING;
     self->xpad = self->ypad = PADDING;
     self->xmargin = self->ymargin = MARGIN;
@@ -3273,6 +5008,12 @@ static void on_size_allocate(GtkWidget* w, GtkAllocation* alloc)
     self->cell_h = fm_config->big_icon_size + self->spacing + self->text_h + self->ypad * 2;
     self->cell_w = MAX((gint)self->text_w, fm_config->big_icon_size) + self->xpad * 2;
 
+    /* labels have to be shaped again if their size was changed */
+    if (self->pango_text_w != old_text_w || self->pango_text_h != old_text_h)
+    {
+        invalidate_labels(self);
+        queue_layout_items(self);
+    }
     update_working_area(self);
     /* queue_layout_items(self); this is called in update_working_area */
 
@@ -3283,12 +5024,19 @@ static void on_size_allocate(GtkWidget* w, GtkAllocation* alloc)
         /* bug SF#958: with GTK 3.8+ font is reset to default after realizing
            so let enforce font description on it right away */
         PangoFontDescription *font_desc = pango_font_description_from_string(self->conf.desktop_font);
-        pango_context_set_font_description(pc, font_desc);
+        /* labels are shaped again only if the font was actually reset */
+        if (!pango_font_description_equal(font_desc,
+                                          pango_context_get_font_description(pc)))
+        {
+            pango_context_set_font_description(pc, font_desc);
+            pango_layout_context_changed(self->pl);
+            invalidate_labels(self);
+            queue_layout_items(self);
+        }
         pango_font_description_free(font_desc);
 #endif
         /* bug #3614866: after monitor geometry was changed we need to redraw
-           the background invalidating all the cache */
-        _clear_bg_cache(self);
+           the background; images are cached by size so new one is made */
         if(self->conf.wallpaper_mode != FM_WP_COLOR && self->conf.wallpaper_mode != FM_WP_TILE)
             update_background(self, -1);
     }
@@ -3345,10 +5093,9 @@ static gboolean on_button_press(GtkWidget* w, GdkEventButton* evt)
 {
     FmDesktop* self = (FmDesktop*)w;
     FmDesktopItem *item = NULL, *clicked_item = NULL;
-    GtkTreeIter it;
     FmFolderViewClickType clicked = FM_FV_CLICK_NONE;
 
-    clicked_item = hit_test(FM_DESKTOP(w), &it, (int)evt->x, (int)evt->y);
+    clicked_item = hit_test(FM_DESKTOP(w), (int)evt->x, (int)evt->y);
 
     /* reset auto-selection now */
     if (self->single_click_timeout_handler != 0)
@@ -3459,12 +5206,12 @@ static gboolean on_button_press(GtkWidget* w, GdkEventButton* evt)
         GtkTreePath* tp = NULL;
 
         if(self->model && clicked_item)
-            tp = gtk_tree_model_get_path(GTK_TREE_MODEL(self->model), &it);
+            tp = fm_desktop_item_get_tree_path(self, clicked_item);
         fm_folder_view_item_clicked(FM_FOLDER_VIEW(self), tp, clicked);
         if(tp)
             gtk_tree_path_free(tp);
         /* SF bug #929: after click the tooltip is still set to the item name */
-        self->hover_item = NULL;
+        set_hover_item(self, NULL);
     }
     /* forward the event to root window */
     else if(evt->button != 1 && evt->button == self->button_pressed)
@@ -3493,7 +5240,7 @@ static gboolean on_button_release(GtkWidget* w, GdkEventButton* evt)
     {
         self->dragging = FALSE;
         /* restore after drag */
-        queue_layout_items(self);
+        queue_layout_items_from(self, 0, FALSE);
     }
     else if((fm_config->single_click && evt->button == 1)
 #if FM_CHECK_VERSION(1, 4, 0)
@@ -3501,8 +5248,7 @@ static gboolean on_button_release(GtkWidget* w, GdkEventButton* evt)
 #endif
                                                          )
     {
-        GtkTreeIter it;
-        FmDesktopItem* clicked_item = hit_test(self, &it, evt->x, evt->y);
+        FmDesktopItem* clicked_item = hit_test(self, evt->x, evt->y);
         if(clicked_item)
             /* single click */
             fm_launch_file_simple(GTK_WINDOW(w), NULL, clicked_item->fi, pcmanfm_open_folder, w);
@@ -3528,7 +5274,6 @@ static gboolean on_single_click_timeout(gpointer user_data)
     int x, y;
     FmDesktopItem *item;
     GdkModifierType state;
-    GtkTreeIter it;
 
     if(g_source_is_destroyed(g_main_current_source()))
         return FALSE;
@@ -3540,7 +5285,7 @@ static gboolean on_single_click_timeout(gpointer user_data)
     /* ensure we are still on the same item */
     window = gtk_widget_get_window(w);
     gdk_window_get_pointer(window, &x, &y, &state);
-    item = hit_test(self, &it, x, y);
+    item = hit_test(self, x, y);
     if (item != self->hover_item)
         return FALSE;
     /* ok, let select the item then */
@@ -3569,8 +5314,7 @@ static gboolean on_motion_notify(GtkWidget* w, GdkEventMotion* evt)
     {
         if(fm_config->single_click)
         {
-            GtkTreeIter it;
-            FmDesktopItem* item = hit_test(self, &it, evt->x, evt->y);
+            FmDesktopItem* item = hit_test(self, evt->x, evt->y);
             FmDesktopItem *hover_item = self->hover_item;
             GdkWindow* window;
 
@@ -3582,12 +5326,9 @@ static gboolean on_motion_notify(GtkWidget* w, GdkEventMotion* evt)
                     self->single_click_timeout_handler = 0;
                 }
                 window = gtk_widget_get_window(w);
-                self->hover_item = item;
-                if (hover_item)
-                    redraw_item(self, hover_item);
+                set_hover_item(self, item);
                 if(item)
                 {
-                    redraw_item(self, item);
                     gdk_window_set_cursor(window, hand_cursor);
 #if FM_CHECK_VERSION(1, 2, 0)
                     if(fm_config->auto_selection_delay > 0)
@@ -3607,18 +5348,9 @@ static gboolean on_motion_notify(GtkWidget* w, GdkEventMotion* evt)
         }
         else
         {
-            GtkTreeIter it;
-            FmDesktopItem* item = hit_test(self, &it, evt->x, evt->y);
-            FmDesktopItem *hover_item = self->hover_item;
+            FmDesktopItem* item = hit_test(self, evt->x, evt->y);
 
-            if(item != hover_item)
-            {
-                self->hover_item = item;
-                if (hover_item)
-                    redraw_item(self, hover_item);
-                if(item)
-                    redraw_item(self, item);
-            }
+            set_hover_item(self, item);
         }
         return TRUE;
     }
@@ -3647,17 +5379,166 @@ static gboolean on_leave_notify(GtkWidget* w, GdkEventCrossing *evt)
     return TRUE;
 }
 
-static gboolean get_focused_item(FmDesktopItem* focus, GtkTreeModel* model, GtkTreeIter* it)
+static gboolean get_focused_item(FmDesktop* desktop, GtkTreeModel* model, GtkTreeIter* it)
 {
     FmDesktopItem* item;
     if(gtk_tree_model_get_iter_first(model, it)) do
     {
-        item = fm_folder_model_get_item_userdata(FM_FOLDER_MODEL(model), it);
-        if(item == focus)
-            return item->is_selected;
+        item = desktop_item_get(desktop, it);
+        if(item == desktop->focus)
+            return item->is_selected;
+    }
+    while(gtk_tree_model_iter_next(model, it));
+    return FALSE;
+}
+
+/* ---- search index ----
+ * Casefolded and normalized names are computed once per item and items are
+ * kept sorted by them, so items whose names start with typed text are found
+ * with binary search. The index is dropped on insertion, deletion or
+ * reordering of rows and is rebuilt when it's needed next time, while a
+ * renamed item is just moved to its new place in the index. */
+static char* search_normalize(const char* text)
+{
+    char *casefold = g_utf8_casefold(text, -1);
+    char *key = g_utf8_normalize(casefold, -1, G_NORMALIZE_ALL);
+
+    g_free(casefold);
+    return key;
+}
+
+static gint _search_sort(gconstpointer a, gconstpointer b)
+{
+    return strcmp((*(FmDesktopItem**)a)->search_key, (*(FmDesktopItem**)b)->search_key);
+}
+
+static void search_index_update(FmDesktop* desktop)
+{
+    GtkTreeModel* model = desktop->model ? GTK_TREE_MODEL(desktop->model) : NULL;
+    GtkTreeIter it;
+    gint row = 0;
+
+    if (desktop->search_valid)
+        return;
+    g_ptr_array_set_size(desktop->search_index, 0);
+    if(model && gtk_tree_model_get_iter_first(model, &it)) do
+    {
+        FmDesktopItem* item = desktop_item_get(desktop, &it);
+        if (item->search_key == NULL)
+            item->search_key = search_normalize(fm_file_info_get_disp_name(item->fi));
+        item->search_row = row++;
+        g_ptr_array_add(desktop->search_index, item);
+    }
+    while(gtk_tree_model_iter_next(model, &it));
+    g_ptr_array_sort(desktop->search_index, _search_sort);
+    desktop->search_valid = TRUE;
+}
+
+/* returns position of first name in the index which is not less than the key */
+static guint _search_lower_bound(GPtrArray* index, const char* key)
+{
+    FmDesktopItem *item;
+    guint lo = 0, hi = index->len, mid;
+
+    while (lo < hi)
+    {
+        mid = lo + (hi - lo) / 2;
+        item = g_ptr_array_index(index, mid);
+        if (strcmp(item->search_key, key) < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+/* updates the key of the item if its display name was changed */
+static void search_index_rename(FmDesktop* desktop, FmDesktopItem* item)
+{
+    GPtrArray *index = desktop->search_index;
+    char *key;
+    guint i;
+
+    if (!desktop->search_valid)
+    {
+        /* it will be made when the index is rebuilt */
+        g_free(item->search_key);
+        item->search_key = NULL;
+        return;
+    }
+    key = search_normalize(fm_file_info_get_disp_name(item->fi));
+    if (strcmp(key, item->search_key) == 0)
+    {
+        g_free(key);
+        return;
+    }
+    /* find the item among ones with the same key */
+    for (i = _search_lower_bound(index, item->search_key); i < index->len; i++)
+        if (g_ptr_array_index(index, i) == item)
+            break;
+    g_free(item->search_key);
+    item->search_key = key;
+    if (G_UNLIKELY(i == index->len)) /* should not happen */
+    {
+        desktop->search_valid = FALSE;
+        return;
+    }
+    g_ptr_array_remove_index(index, i);
+    /* insert it back at the new place, row of the item is not changed */
+    i = _search_lower_bound(index, key);
+    g_ptr_array_add(index, NULL);
+    memmove(&index->pdata[i + 1], &index->pdata[i],
+            (index->len - 1 - i) * sizeof(gpointer));
+    index->pdata[i] = item;
+}
+
+/* checks if the item is after the row from (or before it if backward is
+   TRUE) and is nearer to it than found one */
+static inline gboolean _search_is_nearer(FmDesktopItem* item, FmDesktopItem* found,
+                                         gint from, gboolean backward)
+{
+    if (backward ? item->search_row >= from : item->search_row <= from)
+        return FALSE;
+    if (found == NULL)
+        return TRUE;
+    return backward ? item->search_row > found->search_row
+                    : item->search_row < found->search_row;
+}
+
+/* returns the matched item with the nearest row after the row from, or
+   before it if backward is TRUE; names starting with the key are matched,
+   and if there are no such names then names containing the key */
+static FmDesktopItem* search_index_find(FmDesktop* desktop, const char* key,
+                                        gint from, gboolean backward)
+{
+    GPtrArray *index;
+    FmDesktopItem *item, *found = NULL;
+    gsize len = strlen(key);
+    guint lo;
+    gboolean matched = FALSE;
+
+    search_index_update(desktop);
+    index = desktop->search_index;
+    /* all names with the prefix follow first one not less than the key */
+    for (lo = _search_lower_bound(index, key); lo < index->len; lo++)
+    {
+        item = g_ptr_array_index(index, lo);
+        if (strncmp(item->search_key, key, len) != 0)
+            break;
+        matched = TRUE;
+        if (_search_is_nearer(item, found, from, backward))
+            found = item;
+    }
+    if (matched)
+        return found;
+    for (lo = 0; lo < index->len; lo++)
+    {
+        item = g_ptr_array_index(index, lo);
+        if (strstr(item->search_key, key) != NULL &&
+            _search_is_nearer(item, found, from, backward))
+            found = item;
     }
-    while(gtk_tree_model_iter_next(model, it));
-    return FALSE;
+    return found;
 }
 
 /* ---- Interactive search funcs: mostly picked from ExoIconView ---- */
@@ -3734,67 +5615,31 @@ static void desktop_search_timeout_destroy(gpointer user_data)
 static void desktop_search_move(GtkWidget *widget, FmDesktop *desktop,
                                 gboolean move_up)
 {
-    GtkTreeModel *model;
     const gchar *text;
-    char *casefold, *key, *name;
+    char *key;
     FmDesktopItem *item;
-    GtkTreeIter it;
-    gboolean found = FALSE;
 
     /* check if we have a model */
     if (desktop->model == NULL)
         return;
-    model = GTK_TREE_MODEL(desktop->model);
 
     /* determine the current text for the search entry */
     text = gtk_entry_get_text(GTK_ENTRY(desktop->search_entry));
     if (G_UNLIKELY(text == NULL || text[0] == '\0'))
         return;
 
-    /* determine the iterator of the focused item */
-    if (!get_focused_item(desktop->focus, model, &it))
+    /* search is continued from the focused item */
+    if (desktop->focus == NULL || !desktop->focus->is_selected)
         return;
+    search_index_update(desktop);
 
     /* normalize the pattern */
-    casefold = g_utf8_casefold(text, -1);
-    key = g_utf8_normalize(casefold, -1, G_NORMALIZE_ALL);
-    g_free(casefold);
+    key = search_normalize(text);
     /* let find matched item now */
-    if (move_up)
-    {
-#if GTK_CHECK_VERSION(3, 0, 0)
-        while (!found && gtk_tree_model_iter_previous(model, &it))
-#else
-        GtkTreePath *tp = gtk_tree_model_get_path(model, &it);
-        while (!found && gtk_tree_path_prev(tp) && gtk_tree_model_get_iter(model, &it, tp))
-#endif
-        {
-            item = fm_folder_model_get_item_userdata(desktop->model, &it);
-            casefold = g_utf8_casefold(fm_file_info_get_disp_name(item->fi), -1);
-            name = g_utf8_normalize(casefold, -1, G_NORMALIZE_ALL);
-            g_free(casefold);
-            found = (strncmp(name, key, strlen(key)) == 0);
-            g_free(name);
-        }
-#if !GTK_CHECK_VERSION(3, 0, 0)
-        gtk_tree_path_free(tp);
-#endif
-    }
-    else
-    {
-        while (!found && gtk_tree_model_iter_next(model, &it))
-        {
-            item = fm_folder_model_get_item_userdata(desktop->model, &it);
-            casefold = g_utf8_casefold(fm_file_info_get_disp_name(item->fi), -1);
-            name = g_utf8_normalize(casefold, -1, G_NORMALIZE_ALL);
-            g_free(casefold);
-            found = (strncmp(name, key, strlen(key)) == 0);
-            g_free(name);
-        }
-    }
+    item = search_index_find(desktop, key, desktop->focus->search_row, move_up);
     g_free(key);
 
-    if (!found)
+    if (!item)
         return;
 
     /* unselect all items */
@@ -3886,7 +5731,7 @@ static void desktop_search_activate(GtkEntry *entry, FmDesktop *desktop)
         if (desktop->focus->is_selected)
         {
             model = GTK_TREE_MODEL(desktop->model);
-            if(get_focused_item(desktop->focus, model, &it))
+            if(get_focused_item(desktop, model, &it))
             {
                 tp = gtk_tree_model_get_path(model, &it);
                 fm_folder_view_item_clicked(FM_FOLDER_VIEW(desktop), tp, FM_FV_ACTIVATED);
@@ -3937,17 +5782,13 @@ static void desktop_search_position(FmDesktop *desktop)
 
 static void desktop_search_init(GtkWidget *search_entry, FmDesktop *desktop)
 {
-    GtkTreeModel *model;
     const gchar *text;
-    char *casefold, *key, *name;
+    char *key;
     FmDesktopItem *item;
-    GtkTreeIter it;
-    gboolean found = FALSE;
 
     /* check if we have a model */
     if (desktop->model == NULL)
         return;
-    model = GTK_TREE_MODEL(desktop->model);
 
     /* renew the flush timeout */
     desktop_search_update_timeout(desktop);
@@ -3961,24 +5802,13 @@ static void desktop_search_init(GtkWidget *search_entry, FmDesktop *desktop)
     _unselect_all(FM_FOLDER_VIEW(desktop));
 
     /* normalize the pattern */
-    casefold = g_utf8_casefold(text, -1);
-    key = g_utf8_normalize(casefold, -1, G_NORMALIZE_ALL);
-    g_free(casefold);
+    key = search_normalize(text);
     /* find first matched item now */
-    if (gtk_tree_model_get_iter_first(model, &it)) do
-    {
-        item = fm_folder_model_get_item_userdata(desktop->model, &it);
-        casefold = g_utf8_casefold(fm_file_info_get_disp_name(item->fi), -1);
-        name = g_utf8_normalize(casefold, -1, G_NORMALIZE_ALL);
-        g_free(casefold);
-        found = (strncmp(name, key, strlen(key)) == 0);
-        g_free(name);
-    }
-    while (!found && gtk_tree_model_iter_next(model, &it));
+    item = search_index_find(desktop, key, -1, FALSE);
     g_free(key);
 
     /* focus found item */
-    if (!found)
+    if (!item)
         return;
     _focus_and_select_focused_item(desktop, item);
 }
@@ -4183,7 +6013,7 @@ static gboolean on_key_press(GtkWidget* w, GdkEventKey* evt)
         if(modifier == 0 && desktop->focus)
         {
             model = GTK_TREE_MODEL(desktop->model);
-            if(get_focused_item(desktop->focus, model, &it))
+            if(get_focused_item(desktop, model, &it))
             {
                 tp = gtk_tree_model_get_path(model, &it);
                 fm_folder_view_item_clicked(FM_FOLDER_VIEW(desktop), tp, FM_FV_ACTIVATED);
@@ -4270,6 +6100,7 @@ static void on_style_set(GtkWidget* w, GtkStyle* prev)
     if(font_desc)
         pango_context_set_font_description(pc, font_desc);
     pango_layout_context_changed(self->pl);
+    invalidate_labels(self);
 }
 #endif
 
@@ -4277,6 +6108,7 @@ static void on_direction_changed(GtkWidget* w, GtkTextDirection prev)
 {
     FmDesktop* self = (FmDesktop*)w;
     pango_layout_context_changed(self->pl);
+    invalidate_labels(self);
     queue_layout_items(self);
 }
 
@@ -4312,6 +6144,7 @@ static void on_realize(GtkWidget* w)
     pc = gtk_widget_get_pango_context(w);
     pango_context_set_font_description(pc, font_desc);
     pango_font_description_free(font_desc);
+    invalidate_labels(self);
 #if GTK_CHECK_VERSION(3, 0, 0)
     css_data = g_strdup_printf("FmDesktop {\n"
                                    "background-color: #%02x%02x%02x\n"
@@ -4336,7 +6169,7 @@ static gboolean on_focus_in(GtkWidget* w, GdkEventFocus* evt)
     if(!self->focus && self->model
        && gtk_tree_model_get_iter_first(GTK_TREE_MODEL(self->model), &it))
     {
-        self->focus = fm_folder_model_get_item_userdata(self->model, &it);
+        self->focus = desktop_item_get(self, &it);
         fm_desktop_accessible_focus_set(self, self->focus);
     }
     if(self->focus)
@@ -4366,7 +6199,6 @@ static gboolean on_drag_motion (GtkWidget *dest_widget,
     GdkDragAction action = 0;
     FmDesktop* desktop = FM_DESKTOP(dest_widget);
     FmDesktopItem* item;
-    GtkTreeIter it;
 
     /* we don't support drag & drop if no model is set */
     if (desktop->model == NULL)
@@ -4377,7 +6209,7 @@ static gboolean on_drag_motion (GtkWidget *dest_widget,
     }
 
     /* check if we're dragging over an item */
-    item = hit_test(desktop, &it, x, y);
+    item = hit_test(desktop, x, y);
 
     /* handle moving desktop items */
     if(!item)
@@ -4437,10 +6269,9 @@ static gboolean on_drag_drop (GtkWidget *dest_widget,
 {
     FmDesktop* desktop = FM_DESKTOP(dest_widget);
     FmDesktopItem* item;
-    GtkTreeIter it;
 
     /* check if we're dropping on an item */
-    item = hit_test(desktop, &it, x, y);
+    item = hit_test(desktop, x, y);
 
     /* handle moving desktop items */
     if(!item)
@@ -4480,95 +6311,107 @@ static void on_drag_data_received (GtkWidget *dest_widget,
     g_list_free(items);
 
     /* save position of desktop icons on next idle */
-    queue_config_save(desktop);
+    queue_items_save(desktop);
 
-    queue_layout_items(desktop);
+    queue_layout_items_from(desktop, 0, FALSE);
 
     gtk_drag_finish(drag_context, TRUE, FALSE, time);
 }
 
-static GdkPixbuf *_create_drag_icon(FmDesktop *desktop, gint *x, gint *y)
-{
-    GtkTreeModel *model;
-    FmDesktopItem *item;
-    cairo_surface_t *s;
-    GdkPixbuf *pixbuf;
-    cairo_t *cr;
-    GdkPixbuf *icon;
-    GtkTreeIter it;
-    GdkRectangle area, icon_rect;
 #if !GTK_CHECK_VERSION(3, 0, 0)
+/* converts premultiplied ARGB from cairo into GdkPixbuf RGBA format */
+static void _copy_surface_rect(GdkPixbuf *pixbuf, cairo_surface_t *s,
+                               GdkRectangle *rect)
+{
     guchar *dest_data, *src_data;
     int dest_stride, src_stride, _x, _y;
-#endif
 
-    if (!desktop->model)
-        return NULL;
-    model = GTK_TREE_MODEL(desktop->model);
-    if (!gtk_tree_model_get_iter_first(model, &it))
-        return NULL;
+    dest_stride = gdk_pixbuf_get_rowstride(pixbuf);
+    src_stride = cairo_image_surface_get_stride(s);
+    dest_data = gdk_pixbuf_get_pixels(pixbuf) + rect->y * dest_stride + rect->x * 4;
+    src_data = cairo_image_surface_get_data(s) + rect->y * src_stride + rect->x * 4;
 
-    /* determine the size of complete pixbuf */
-    area.width = 0; /* mark it */
-    do
+    for (_y = 0; _y < rect->height; _y++)
     {
-        item = fm_folder_model_get_item_userdata(desktop->model, &it);
-        if (!item->is_selected)
-            continue;
-        if (area.width == 0)
-            area = item->icon_rect;
-        else
+        guint32 *src = (guint32 *) src_data;
+
+        for (_x = 0; _x < rect->width; _x++)
         {
-            if (item->icon_rect.x < area.x)
+            guint alpha = src[_x] >> 24;
+            guint32 mul;
+
+            if (alpha == 0)
             {
-                area.width += (area.x - item->icon_rect.x);
-                area.x = item->icon_rect.x;
+                dest_data[_x * 4 + 0] = 0;
+                dest_data[_x * 4 + 1] = 0;
+                dest_data[_x * 4 + 2] = 0;
+            }
+            else if (alpha == 0xff) /* no division for opaque pixels */
+            {
+                dest_data[_x * 4 + 0] = (src[_x] & 0xff0000) >> 16;
+                dest_data[_x * 4 + 1] = (src[_x] & 0x00ff00) >>  8;
+                dest_data[_x * 4 + 2] = (src[_x] & 0x0000ff) >>  0;
             }
-            if (item->icon_rect.x + item->icon_rect.width > area.x + area.width)
-                area.width = item->icon_rect.x + item->icon_rect.width - area.x;
-            if (item->icon_rect.y < area.y)
+            else
             {
-                area.height += (area.y - item->icon_rect.y);
-                area.y = item->icon_rect.y;
+                /* one division per pixel instead of one per channel */
+                mul = (255 * 65536 + alpha / 2) / alpha;
+                dest_data[_x * 4 + 0] = (((src[_x] & 0xff0000) >> 16) * mul + 32768) >> 16;
+                dest_data[_x * 4 + 1] = (((src[_x] & 0x00ff00) >>  8) * mul + 32768) >> 16;
+                dest_data[_x * 4 + 2] = (((src[_x] & 0x0000ff) >>  0) * mul + 32768) >> 16;
             }
-            if (item->icon_rect.y + item->icon_rect.height > area.y + area.height)
-                area.height = item->icon_rect.y + item->icon_rect.height - area.y;
+            dest_data[_x * 4 + 3] = alpha;
         }
+        src_data += src_stride;
+        dest_data += dest_stride;
     }
-    while(gtk_tree_model_iter_next(model, &it));
+}
+#endif
 
-    /* now create the pixbuf */
-    if (area.width == 0) /* no selection??? */
+static GdkPixbuf *_create_drag_icon(FmDesktop *desktop, gint *x, gint *y)
+{
+    GList *items, *l;
+    FmDesktopItem *item;
+    cairo_surface_t *s, *icon;
+    GdkPixbuf *pixbuf;
+    cairo_t *cr;
+    GdkRectangle area, icon_rect;
+
+    /* walk the model only once, the rest is done on the list */
+    items = get_selected_items(desktop, NULL);
+    if (items == NULL) /* no selection??? */
         return NULL;
+
+    /* determine the size of complete pixbuf */
+    area = ((FmDesktopItem*)items->data)->icon_rect;
+    for (l = items->next; l; l = l->next)
+        gdk_rectangle_union(&area, &((FmDesktopItem*)l->data)->icon_rect, &area);
+
+    /* now create the pixbuf */
     area.width += 2;
     area.height += 2;
     s = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, area.width, area.height);
     cr = cairo_create(s);
 
-    gtk_tree_model_get_iter_first(model, &it);
-    do
+    for (l = items; l; l = l->next)
     {
-        item = fm_folder_model_get_item_userdata(desktop->model, &it);
-        if (!item->is_selected)
-            continue;
+        item = l->data;
         /* FIXME: should we render name too, or is it too heavy? */
-        icon = NULL;
-        gtk_tree_model_get(model, &it, FM_FOLDER_MODEL_COL_ICON, &icon, -1);
-        /* draw the icon */
+        icon_rect.x = item->icon_rect.x - area.x + 1;
+        icon_rect.width = item->icon_rect.width;
+        icon_rect.y = item->icon_rect.y - area.y + 1;
+        icon_rect.height = item->icon_rect.height;
+        /* draw the icon, use the surface rendered for the desktop if any */
+        icon = get_item_icon(desktop, item, 0);
         if (icon)
-        {
-            icon_rect.x = item->icon_rect.x - area.x + 1;
-            icon_rect.width = item->icon_rect.width;
-            icon_rect.y = item->icon_rect.y - area.y + 1;
-            icon_rect.height = item->icon_rect.height;
-//g_debug("icon at %d %d %d %d",icon_rect.x,icon_rect.y,icon_rect.width,icon_rect.height);
-            gdk_cairo_set_source_pixbuf(cr, icon, icon_rect.x, icon_rect.y);
-            gdk_cairo_rectangle(cr, &icon_rect);
-            cairo_fill(cr);
-            g_object_unref(icon);
-        }
+            cairo_set_source_surface(cr, icon, icon_rect.x, icon_rect.y);
+        else if (item->icon)
+            gdk_cairo_set_source_pixbuf(cr, item->icon, icon_rect.x, icon_rect.y);
+        else
+            continue;
+        gdk_cairo_rectangle(cr, &icon_rect);
+        cairo_fill(cr);
     }
-    while(gtk_tree_model_iter_next(model, &it));
 
     cairo_destroy (cr);
 #if GTK_CHECK_VERSION(3, 0, 0)
@@ -4576,42 +6419,23 @@ static GdkPixbuf *_create_drag_icon(FmDesktop *desktop, gint *x, gint *y)
 #else
     /* GTK2 has no API gdk_pixbuf_get_from_surface() but we cannot
        preserve transparency using gdk_pixbuf_get_from_drawable() so
-       therefore have to implement that API behavior here instead */
+       therefore have to implement that API behavior here instead;
+       only areas of icons are converted, the rest is transparent */
     pixbuf = gdk_pixbuf_new(GDK_COLORSPACE_RGB, TRUE, 8, area.width, area.height);
+    gdk_pixbuf_fill(pixbuf, 0);
     cairo_surface_flush(s);
-    dest_data = gdk_pixbuf_get_pixels(pixbuf);
-    dest_stride = gdk_pixbuf_get_rowstride(pixbuf);
-    src_data = cairo_image_surface_get_data(s);
-    src_stride = cairo_image_surface_get_stride(s);
-
-    /* convert alpha from cairo_surface_t into GdkPixbuf format */
-    for (_y = 0; _y < area.height; _y++)
+    for (l = items; l; l = l->next)
     {
-        guint32 *src = (guint32 *) src_data;
-
-        for (_x = 0; _x < area.width; _x++)
-        {
-            guint alpha = src[_x] >> 24;
-
-            if (alpha == 0)
-            {
-                dest_data[_x * 4 + 0] = 0;
-                dest_data[_x * 4 + 1] = 0;
-                dest_data[_x * 4 + 2] = 0;
-            }
-            else
-            {
-                dest_data[_x * 4 + 0] = (((src[_x] & 0xff0000) >> 16) * 255 + alpha / 2) / alpha;
-                dest_data[_x * 4 + 1] = (((src[_x] & 0x00ff00) >>  8) * 255 + alpha / 2) / alpha;
-                dest_data[_x * 4 + 2] = (((src[_x] & 0x0000ff) >>  0) * 255 + alpha / 2) / alpha;
-            }
-            dest_data[_x * 4 + 3] = alpha;
-        }
-        src_data += src_stride;
-        dest_data += dest_stride;
+        item = l->data;
+        icon_rect.x = item->icon_rect.x - area.x + 1;
+        icon_rect.width = item->icon_rect.width;
+        icon_rect.y = item->icon_rect.y - area.y + 1;
+        icon_rect.height = item->icon_rect.height;
+        _copy_surface_rect(pixbuf, s, &icon_rect);
     }
 #endif
     cairo_surface_destroy(s);
+    g_list_free(items);
     *x = area.x;
     *y = area.y;
     return pixbuf;
@@ -4635,7 +6459,7 @@ static void on_drag_begin (GtkWidget *widget, GdkDragContext *drag_context)
         g_object_unref(pix);
     }
 
-    queue_layout_items(desktop);
+    queue_layout_items_from(desktop, 0, FALSE);
 }
 
 static void on_dnd_src_data_get(FmDndSrc* ds, FmDesktop* desktop)
@@ -4751,15 +6575,69 @@ static void on_sort_changed(GtkTreeSortable *model, FmDesktop *desktop)
 }
 #endif
 
+/* returns model of another desktop which can be used for this one too */
+static FmFolderModel *find_shared_model(FmDesktop *desktop, FmFolder *folder)
+{
+    FmDesktop *other;
+    int i;
+
+    if (!app_config->desktop_share_model)
+        return NULL;
+    for (i = 0; i < n_screens; i++)
+    {
+        other = desktops[i];
+        if (other == desktop || other->model == NULL ||
+            fm_folder_model_get_folder(other->model) != folder)
+            continue;
+        /* sorting and extra items are properties of the model */
+        if (other->conf.desktop_sort_by != desktop->conf.desktop_sort_by ||
+            other->conf.desktop_sort_type != desktop->conf.desktop_sort_type)
+            continue;
+#if FM_CHECK_VERSION(1, 2, 0)
+        if (other->conf.show_documents != desktop->conf.show_documents ||
+            other->conf.show_trash != desktop->conf.show_trash ||
+            other->conf.show_mounts != desktop->conf.show_mounts)
+            continue;
+#endif
+        return other->model;
+    }
+    return NULL;
+}
+
+/* returns TRUE if model of the desktop is used by another desktop too */
+static gboolean is_model_shared(FmDesktop *desktop)
+{
+    int i;
+
+    for (i = 0; i < n_screens; i++)
+        if (desktops[i] != desktop && desktops[i]->model == desktop->model)
+            return TRUE;
+    return FALSE;
+}
+
 static inline void connect_model(FmDesktop *desktop, FmFolder *folder)
 {
-    desktop->model = fm_folder_model_new(folder, FALSE);
+    FmFolderModel *model = find_shared_model(desktop, folder);
+    GtkTreeIter it;
+
+    if (model)
+    {
+        /* rows are there already so add own items for them */
+        desktop->model = g_object_ref(model);
+        if (gtk_tree_model_get_iter_first(GTK_TREE_MODEL(model), &it)) do
+            desktop_item_new(desktop, model, &it);
+        while (gtk_tree_model_iter_next(GTK_TREE_MODEL(model), &it));
+    }
+    else
+    {
+        desktop->model = fm_folder_model_new(folder, FALSE);
+        fm_folder_model_set_icon_size(desktop->model, fm_config->big_icon_size);
+        g_signal_connect(app_config, "changed::big_icon_size",
+                         G_CALLBACK(on_big_icon_size_changed), desktop->model);
+    }
     g_signal_connect(folder, "start-loading", G_CALLBACK(on_folder_start_loading), desktop);
     g_signal_connect(folder, "finish-loading", G_CALLBACK(on_folder_finish_loading), desktop);
     g_signal_connect(folder, "error", G_CALLBACK(on_folder_error), desktop);
-    fm_folder_model_set_icon_size(desktop->model, fm_config->big_icon_size);
-    g_signal_connect(app_config, "changed::big_icon_size",
-                     G_CALLBACK(on_big_icon_size_changed), desktop->model);
     g_signal_connect(desktop->model, "row-deleting", G_CALLBACK(on_row_deleting), desktop);
     g_signal_connect(desktop->model, "row-inserted", G_CALLBACK(on_row_inserted), desktop);
     g_signal_connect(desktop->model, "row-deleted", G_CALLBACK(on_row_deleted), desktop);
@@ -4773,6 +6651,10 @@ static inline void connect_model(FmDesktop *desktop, FmFolder *folder)
     gtk_tree_sortable_set_sort_column_id(GTK_TREE_SORTABLE(desktop->model),
                                          desktop->conf.desktop_sort_by,
                                          desktop->conf.desktop_sort_type);
+#endif
+#if FM_CHECK_VERSION(1, 2, 0)
+    if (model == NULL)
+        add_extra_items_to_model(desktop);
 #endif
     on_folder_start_loading(folder, desktop);
     if(fm_folder_is_loaded(folder))
@@ -4782,14 +6664,19 @@ static inline void connect_model(FmDesktop *desktop, FmFolder *folder)
 static inline void disconnect_model(FmDesktop* desktop)
 {
     FmFolder *folder;
+    GtkTreeIter it;
+    gboolean shared;
 
     if (desktop->model == NULL)
         return;
+    fm_desktop_accessible_model_removed(desktop);
     folder = fm_folder_model_get_folder(desktop->model);
     g_signal_handlers_disconnect_by_func(folder, on_folder_start_loading, desktop);
     g_signal_handlers_disconnect_by_func(folder, on_folder_finish_loading, desktop);
     g_signal_handlers_disconnect_by_func(folder, on_folder_error, desktop);
-    g_signal_handlers_disconnect_by_func(app_config, on_big_icon_size_changed, desktop->model);
+    shared = is_model_shared(desktop);
+    if (!shared)
+        g_signal_handlers_disconnect_by_func(app_config, on_big_icon_size_changed, desktop->model);
     g_signal_handlers_disconnect_by_func(desktop->model, on_row_deleting, desktop);
     g_signal_handlers_disconnect_by_func(desktop->model, on_row_inserted, desktop);
     g_signal_handlers_disconnect_by_func(desktop->model, on_row_deleted, desktop);
@@ -4798,14 +6685,57 @@ static inline void disconnect_model(FmDesktop* desktop)
 #if FM_CHECK_VERSION(1, 0, 2)
     g_signal_handlers_disconnect_by_func(desktop->model, on_sort_changed, desktop);
 #endif
+    grid_clear(desktop);
+    desktop->search_valid = FALSE;
+    /* model stays alive so remove own items from it */
+    if (shared)
+    {
+        if (desktop->items_changed)
+            pos_store_sync(desktop);
+        unload_items(desktop);
+    }
+    if (shared && gtk_tree_model_get_iter_first(GTK_TREE_MODEL(desktop->model), &it)) do
+    {
+        FmDesktopItem *item = desktop_item_get(desktop, &it);
+
+        if (item == NULL)
+            continue;
+        desktop_item_unlink(desktop->model, &it, item);
+        desktop_item_free(item);
+    }
+    while (gtk_tree_model_iter_next(GTK_TREE_MODEL(desktop->model), &it));
+    /* otherwise items will be freed with the model */
+    g_slist_free(desktop->changed_items);
+    desktop->changed_items = NULL;
+    if (desktop->idle_changed)
+    {
+        g_source_remove(desktop->idle_changed);
+        desktop->idle_changed = 0;
+    }
     g_object_unref(desktop->model);
     desktop->model = NULL;
-    fm_desktop_accessible_model_removed(desktop);
     /* update popup now */
     fm_folder_view_add_popup(FM_FOLDER_VIEW(desktop), GTK_WINDOW(desktop),
                              fm_desktop_update_popup);
 }
 
+#if FM_CHECK_VERSION(1, 2, 0)
+/* config of the desktop was changed so if it shares model with other desktops
+   then it should use another one; returns TRUE if model was replaced */
+static gboolean reconnect_shared_model(FmDesktop *desktop)
+{
+    FmFolder *folder;
+
+    if (desktop->model == NULL || !is_model_shared(desktop))
+        return FALSE;
+    folder = g_object_ref(fm_folder_model_get_folder(desktop->model));
+    disconnect_model(desktop);
+    connect_model(desktop, folder);
+    g_object_unref(folder);
+    return TRUE;
+}
+#endif
+
 #if FM_CHECK_VERSION(1, 2, 0)
 static void on_show_full_names_changed(FmConfig *cfg, FmDesktop *self)
 {
@@ -4819,6 +6749,7 @@ static void on_show_full_names_changed(FmConfig *cfg, FmDesktop *self)
         self->pango_text_h = self->text_h * PANGO_SCALE;
         pango_layout_set_ellipsize(self->pl, PANGO_ELLIPSIZE_END);
     }
+    invalidate_labels(self);
     queue_layout_items(self);
 }
 #endif
@@ -4845,6 +6776,9 @@ static void fm_desktop_destroy(GtkObject *object)
 
         gtk_window_group_remove_window(win_group, (GtkWindow*)self);
 
+        /* save positions now while items are still alive */
+        if (self->items_changed)
+            pos_store_sync(self);
         if (self->model)
             disconnect_model(self);
 
@@ -4853,6 +6787,19 @@ static void fm_desktop_destroy(GtkObject *object)
         g_object_unref(self->icon_render);
         self->icon_render = NULL;
         g_object_unref(self->pl);
+        g_hash_table_destroy(self->grid);
+        self->grid = NULL;
+        g_ptr_array_free(self->nav_x, TRUE);
+        self->nav_x = NULL;
+        g_ptr_array_free(self->nav_y, TRUE);
+        self->nav_y = NULL;
+        g_ptr_array_free(self->search_index, TRUE);
+        self->search_index = NULL;
+        if (self->positions)
+        {
+            g_hash_table_destroy(self->positions);
+            self->positions = NULL;
+        }
 
         if(self->single_click_timeout_handler)
             g_source_remove(self->single_click_timeout_handler);
@@ -4860,6 +6807,9 @@ static void fm_desktop_destroy(GtkObject *object)
         if(self->idle_layout)
             g_source_remove(self->idle_layout);
 
+        if(self->idle_changed)
+            g_source_remove(self->idle_changed);
+
         g_signal_handlers_disconnect_by_func(self->dnd_src, on_dnd_src_data_get, self);
         g_object_unref(self->dnd_src);
         g_object_unref(self->dnd_dest);
@@ -4869,7 +6819,7 @@ static void fm_desktop_destroy(GtkObject *object)
     {
         self->conf.configured = FALSE;
         if (self->conf.changed) /* if config was changed then save it now */
-            save_item_pos(self);
+            save_desktop_config(self);
         g_free(self->conf.wallpaper);
         if (self->conf.wallpapers_configured > 0)
         {
@@ -4891,6 +6841,13 @@ static void fm_desktop_destroy(GtkObject *object)
         self->search_timeout_id = 0;
     }
 
+    if (self->accessible)
+    {
+        g_object_remove_weak_pointer(G_OBJECT(self->accessible),
+                                     (gpointer)&self->accessible);
+        self->accessible = NULL;
+    }
+
     /* destroy the interactive search dialog */
     if (G_UNLIKELY(self->search_window))
     {
@@ -4921,6 +6878,7 @@ static void fm_desktop_init(FmDesktop *self)
     gtk_widget_set_style((GtkWidget*)self, style);
     g_object_unref(style);
 #endif
+    self->layout_from = G_MAXINT;
 }
 
 /* we should have a constructor to handle parameters */
@@ -4971,6 +6929,10 @@ static GObject* fm_desktop_constructor(GType type, guint n_construct_properties,
 #endif
         pango_layout_set_ellipsize(self->pl, PANGO_ELLIPSIZE_END);
     pango_layout_set_wrap(self->pl, PANGO_WRAP_WORD_CHAR);
+    self->grid = g_hash_table_new(g_direct_hash, g_direct_equal);
+    self->nav_x = g_ptr_array_new();
+    self->nav_y = g_ptr_array_new();
+    self->search_index = g_ptr_array_new();
 #if FM_CHECK_VERSION(1, 2, 0)
     g_signal_connect(app_config, "changed::show_full_names",
                      G_CALLBACK(on_show_full_names_changed), self);
@@ -5191,7 +7153,7 @@ static gint _count_selected_files(FmFolderView* fv)
         return 0;
     do
     {
-        FmDesktopItem* item = fm_folder_model_get_item_userdata(desktop->model, &it);
+        FmDesktopItem* item = desktop_item_get(desktop, &it);
         if(item->is_selected)
             n++;
     }
@@ -5213,7 +7175,7 @@ static FmFileInfoList* _dup_selected_files(FmFolderView* fv)
         return NULL;
     do
     {
-        FmDesktopItem* item = fm_folder_model_get_item_userdata(desktop->model, &it);
+        FmDesktopItem* item = desktop_item_get(desktop, &it);
         if(item->is_selected)
         {
             if(!files)
@@ -5239,7 +7201,7 @@ static FmPathList* _dup_selected_file_paths(FmFolderView* fv)
         return NULL;
     do
     {
-        FmDesktopItem* item = fm_folder_model_get_item_userdata(desktop->model, &it);
+        FmDesktopItem* item = desktop_item_get(desktop, &it);
         if(item->is_selected)
         {
             if(!files)
@@ -5264,7 +7226,7 @@ static void _select_all(FmFolderView* fv)
         return;
     do
     {
-        FmDesktopItem* item = fm_folder_model_get_item_userdata(desktop->model, &it);
+        FmDesktopItem* item = desktop_item_get(desktop, &it);
         if(!item->is_selected)
         {
             item->is_selected = TRUE;
@@ -5288,7 +7250,7 @@ static void _unselect_all(FmFolderView* fv)
         return;
     do
     {
-        FmDesktopItem* item = fm_folder_model_get_item_userdata(desktop->model, &it);
+        FmDesktopItem* item = desktop_item_get(desktop, &it);
         if(item->is_selected)
         {
             item->is_selected = FALSE;
@@ -5497,6 +7459,8 @@ static void on_desktop_font_set(GtkFontButton* btn, FmDesktop *desktop)
 
             pango_context_set_font_description(pc, font_desc);
             pango_layout_context_changed(desktop->pl);
+            invalidate_labels(desktop);
+            queue_layout_items(desktop);
             gtk_widget_queue_resize(GTK_WIDGET(desktop));
             pango_font_description_free(font_desc);
         }
@@ -5518,7 +7482,8 @@ static void on_show_documents_toggled(GtkToggleButton* btn, FmDesktop *desktop)
     {
         desktop->conf.show_documents = new_val;
         queue_config_save(desktop);
-        if (documents && documents->fi && desktop->model)
+        if (!reconnect_shared_model(desktop) &&
+            documents && documents->fi && desktop->model)
         {
             if (new_val)
                 fm_folder_model_extra_file_add(desktop->model, documents->fi,
@@ -5537,7 +7502,8 @@ static void on_show_trash_toggled(GtkToggleButton* btn, FmDesktop *desktop)
     {
         desktop->conf.show_trash = new_val;
         queue_config_save(desktop);
-        if (trash_can && trash_can->fi && desktop->model)
+        if (!reconnect_shared_model(desktop) &&
+            trash_can && trash_can->fi && desktop->model)
         {
             if (new_val)
                 fm_folder_model_extra_file_add(desktop->model, trash_can->fi,
@@ -5557,15 +7523,16 @@ static void on_show_mounts_toggled(GtkToggleButton* btn, FmDesktop *desktop)
     {
         desktop->conf.show_mounts = new_val;
         queue_config_save(desktop);
-        if (desktop->model) for (msl = mounts; msl; msl = msl->next)
-        {
-            FmDesktopExtraItem *mount = msl->data;
-            if (new_val)
-                fm_folder_model_extra_file_add(desktop->model, mount->fi,
-                                               FM_FOLDER_MODEL_ITEMPOS_POST);
-            else
-                fm_folder_model_extra_file_remove(desktop->model, mount->fi);
-        }
+        if (!reconnect_shared_model(desktop) && desktop->model)
+            for (msl = mounts; msl; msl = msl->next)
+            {
+                FmDesktopExtraItem *mount = msl->data;
+                if (new_val)
+                    fm_folder_model_extra_file_add(desktop->model, mount->fi,
+                                                   FM_FOLDER_MODEL_ITEMPOS_POST);
+                else
+                    fm_folder_model_extra_file_remove(desktop->model, mount->fi);
+            }
     }
 }
 #endif
@@ -5804,10 +7771,104 @@ void fm_desktop_preference(GtkAction *act, FmDesktop *desktop)
 /* ---------------------------------------------------------------------
     Interface functions */
 
+/* ---- per-monitor initialization ----
+ * Only the primary monitor of each screen is initialized at startup, the
+ * rest are brought up one by one from an idle handler so the first desktop
+ * appears as soon as possible. Wallpapers are rendered by a pool of threads
+ * so images for different monitors are decoded in parallel. */
+static void _init_desktop(FmDesktop *desktop)
+{
+    GtkWidget *widget = GTK_WIDGET(desktop);
+    FmFolder *desktop_folder;
+    GTimer *timer = g_timer_new();
+
+    /* realize it: without this, setting wallpaper or font won't work */
+    gtk_widget_realize(widget);
+    /* realizing also loads config */
+    if (desktop->conf.folder)
+    {
+        if (desktop->conf.folder[0])
+            desktop_folder = fm_folder_from_path_name(desktop->conf.folder);
+        else
+            desktop_folder = NULL;
+    }
+    else
+        desktop_folder = fm_folder_from_path(fm_path_get_desktop());
+    if (desktop_folder)
+    {
+        connect_model(desktop, desktop_folder);
+        g_object_unref(desktop_folder);
+    }
+    else
+        /* we have to add popup here because it will be never
+           set by connect_model() as latter wasn't called */
+        fm_folder_view_add_popup(FM_FOLDER_VIEW(desktop),
+                                 GTK_WINDOW(desktop),
+                                 fm_desktop_update_popup);
+    if (desktop->model)
+#if FM_CHECK_VERSION(1, 0, 2)
+        fm_folder_model_set_sort(desktop->model,
+                                 desktop->conf.desktop_sort_by,
+                                 desktop->conf.desktop_sort_type);
+#else
+        gtk_tree_sortable_set_sort_column_id(GTK_TREE_SORTABLE(desktop->model),
+                                             desktop->conf.desktop_sort_by,
+                                             desktop->conf.desktop_sort_type);
+#endif
+    gtk_widget_show_all(widget);
+    gdk_window_lower(gtk_widget_get_window(widget));
+    g_debug("desktop for monitor %d initialized in %.3f ms", desktop->monitor,
+            g_timer_elapsed(timer, NULL) * 1000.0);
+    g_timer_destroy(timer);
+}
+
+static gboolean on_idle_desktops_init(gpointer unused)
+{
+    FmDesktop *desktop;
+
+    if (g_source_is_destroyed(g_main_current_source()))
+        return FALSE;
+    if (pending_desktops == NULL)
+    {
+        idle_desktops_init = 0;
+        return FALSE;
+    }
+    desktop = pending_desktops->data;
+    pending_desktops = g_slist_delete_link(pending_desktops, pending_desktops);
+    _init_desktop(desktop);
+    if (pending_desktops)
+        return TRUE;
+    idle_desktops_init = 0;
+    return FALSE;
+}
+
+/* removes desktop from the queue, returns FALSE if it was not there */
+static gboolean _forget_pending_desktop(FmDesktop *desktop)
+{
+    GSList *l = g_slist_find(pending_desktops, desktop);
+
+    if (l == NULL)
+        return FALSE;
+    pending_desktops = g_slist_delete_link(pending_desktops, l);
+    if (pending_desktops == NULL && idle_desktops_init)
+    {
+        g_source_remove(idle_desktops_init);
+        idle_desktops_init = 0;
+    }
+    return TRUE;
+}
+
+/* initializes desktop now if it still waits in the queue */
+static void _init_pending_desktop(FmDesktop *desktop)
+{
+    if (_forget_pending_desktop(desktop))
+        _init_desktop(desktop);
+}
+
 void fm_desktop_manager_init(gint on_screen)
 {
     GdkDisplay * gdpy;
-    int i, n_scr, n_mon, scr, mon;
+    int i, n_scr, n_mon, scr, mon, primary;
     const char* desktop_path;
 #if FM_CHECK_VERSION(1, 2, 0)
     GFile *gf;
@@ -5832,53 +7893,30 @@ void fm_desktop_manager_init(gint on_screen)
     {
         GdkScreen* screen = gdk_display_get_screen(gdpy, scr);
         n_mon = gdk_screen_get_n_monitors(screen);
+#if GTK_CHECK_VERSION(2, 20, 0)
+        primary = gdk_screen_get_primary_monitor(screen);
+#else
+        primary = 0;
+#endif
         for(mon = 0; mon < n_mon; mon++)
         {
             gint mon_init = (on_screen < 0 || on_screen == (int)scr) ? (int)mon : (mon ? -2 : -1);
             FmDesktop *desktop = fm_desktop_new(screen, mon_init);
-            GtkWidget *widget = GTK_WIDGET(desktop);
-            FmFolder *desktop_folder;
 
             desktops[i++] = desktop;
             if(mon_init < 0)
                 continue;
-            /* realize it: without this, setting wallpaper or font won't work */
-            gtk_widget_realize(widget);
-            /* realizing also loads config */
-            if (desktop->conf.folder)
-            {
-                if (desktop->conf.folder[0])
-                    desktop_folder = fm_folder_from_path_name(desktop->conf.folder);
-                else
-                    desktop_folder = NULL;
-            }
-            else
-                desktop_folder = fm_folder_from_path(fm_path_get_desktop());
-            if (desktop_folder)
+            /* other monitors will be initialized after the primary one */
+            if (mon != primary)
             {
-                connect_model(desktop, desktop_folder);
-                g_object_unref(desktop_folder);
+                pending_desktops = g_slist_append(pending_desktops, desktop);
+                continue;
             }
-            else
-                /* we have to add popup here because it will be never
-                   set by connect_model() as latter wasn't called */
-                fm_folder_view_add_popup(FM_FOLDER_VIEW(desktop),
-                                         GTK_WINDOW(desktop),
-                                         fm_desktop_update_popup);
-            if (desktop->model)
-#if FM_CHECK_VERSION(1, 0, 2)
-                fm_folder_model_set_sort(desktop->model,
-                                         desktop->conf.desktop_sort_by,
-                                         desktop->conf.desktop_sort_type);
-#else
-                gtk_tree_sortable_set_sort_column_id(GTK_TREE_SORTABLE(desktop->model),
-                                                     desktop->conf.desktop_sort_by,
-                                                     desktop->conf.desktop_sort_type);
-#endif
-            gtk_widget_show_all(widget);
-            gdk_window_lower(gtk_widget_get_window(widget));
+            _init_desktop(desktop);
         }
     }
+    if (pending_desktops)
+        idle_desktops_init = gdk_threads_add_idle(on_idle_desktops_init, NULL);
 
     icon_theme_changed = g_signal_connect(gtk_icon_theme_get_default(), "changed", G_CALLBACK(on_icon_theme_changed), NULL);
 
@@ -5929,6 +7967,13 @@ void fm_desktop_manager_finalize()
         g_source_remove(idle_config_save);
         idle_config_save = 0;
     }
+    if (idle_desktops_init)
+    {
+        g_source_remove(idle_desktops_init);
+        idle_desktops_init = 0;
+    }
+    g_slist_free(pending_desktops);
+    pending_desktops = NULL;
     for(i = 0; i < n_screens; i++)
     {
         gtk_widget_destroy(GTK_WIDGET(desktops[i]));
@@ -5936,7 +7981,35 @@ void fm_desktop_manager_finalize()
     g_free(desktops);
     n_screens = 0;
     g_object_unref(win_group);
+    if (bg_pool)
+    {
+        /* wait for wallpapers being rendered */
+        g_thread_pool_free(bg_pool, FALSE, TRUE);
+        bg_pool = NULL;
+    }
+    if (bg_refresh_timeout)
+    {
+        g_source_remove(bg_refresh_timeout);
+        bg_refresh_timeout = 0;
+    }
+    if (bg_jobs)
+    {
+        /* remaining jobs will be freed by their idle callbacks */
+        g_hash_table_destroy(bg_jobs);
+        bg_jobs = NULL;
+    }
+    while (bg_cache_lru.head)
+        _bg_cache_remove(bg_cache_lru.head->data);
+    if (bg_cache)
+    {
+        g_hash_table_destroy(bg_cache);
+        bg_cache = NULL;
+    }
+    /* monitors of files used by remaining jobs are left until they finish */
     win_group = NULL;
+#ifdef G_ENABLE_DEBUG
+    stats_report();
+#endif
 
     g_signal_handler_disconnect(gtk_icon_theme_get_default(), icon_theme_changed);
 
@@ -5951,6 +8024,7 @@ void fm_desktop_manager_finalize()
     }
 
 #if FM_CHECK_VERSION(1, 2, 0)
+    _cancel_extra_items();
     if (G_LIKELY(documents))
     {
         _free_extra_item(documents);
@@ -5960,6 +8034,18 @@ void fm_desktop_manager_finalize()
     {
         g_signal_handlers_disconnect_by_func(trash_monitor, on_trash_changed, trash_can);
         g_object_unref(trash_monitor);
+        if (trash_update_timeout)
+        {
+            g_source_remove(trash_update_timeout);
+            trash_update_timeout = 0;
+        }
+        if (trash_query)
+        {
+            /* callback will see it and do nothing */
+            g_cancellable_cancel(trash_query);
+            g_object_unref(trash_query);
+            trash_query = NULL;
+        }
         _free_extra_item(trash_can);
         trash_can = NULL;
     }
@@ -5986,7 +8072,11 @@ FmDesktop* fm_desktop_get(gint screen, gint monitor)
     while(i < n_screens && n <= screen)
     {
         if(n == screen && desktops[i]->monitor == monitor)
+        {
+            /* caller may want to change it so it should be ready */
+            _init_pending_desktop(desktops[i]);
             return desktops[i];
+        }
         i++;
         if(i < n_screens &&
            (desktops[i]->monitor == 0 || desktops[i]->monitor == -1))
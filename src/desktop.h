@@ -53,6 +53,12 @@ struct _FmDesktop
     PangoLayout* pl;
     FmCellRendererPixbuf* icon_render;
     GList* fixed_items;
+    GHashTable *grid; /* spatial index: cell -> GSList of items */
+    GPtrArray *nav_x; /* items sorted by x then y, for keyboard navigation */
+    GPtrArray *nav_y; /* items sorted by y then x */
+    GPtrArray *search_index; /* items sorted by search key */
+    GHashTable *positions; /* saved positions: file name -> FmDesktopItemPos */
+    guint pos_journal; /* number of outdated records in the positions store */
     guint xpad;
     guint ypad;
     guint spacing;
@@ -76,7 +82,14 @@ struct _FmDesktop
     gboolean forward_pending : 1;
     gboolean dragging : 1;
     gboolean layout_pending : 1;
+    gboolean layout_resize : 1; /* item sizes should be recalculated on next layout */
+    gboolean items_changed : 1; /* positions of items should be saved */
+    gboolean nav_valid : 1; /* nav_x and nav_y are up to date */
+    gboolean search_valid : 1; /* search_index is up to date */
     guint idle_layout;
+    guint idle_changed; /* idle handler to apply changed_items */
+    GSList *changed_items; /* items with changed data, not resized yet */
+    gint layout_from; /* first row which needs relayout, G_MAXINT if none */
     FmDndSrc* dnd_src;
     FmDndDest* dnd_dest;
     guint single_click_timeout_handler;
@@ -84,10 +97,12 @@ struct _FmDesktop
     FmFolderModel* model;
     guint cur_desktop;
     gint monitor;
-    FmBackgroundCache *cache;
+    FmBackgroundCache *cache; /* wallpaper image shown on the desktop */
+    guint bg_serial; /* id of the last requested background update */
 #if GTK_CHECK_VERSION(3, 0, 0)
     GtkCssProvider *css;
 #endif
+    AtkObject *accessible; /* weak pointer, NULL until it's requested */
     /* interactive search subwindow */
     GtkWidget *search_window;
     GtkWidget *search_entry;
@@ -1657,9 +1657,8 @@ static void update_statusbar(FmMainWin* win)
         gtk_widget_hide(GTK_WIDGET(win->vol_status));
 }
 
-gint fm_main_win_add_tab(FmMainWin* win, FmPath* path)
+static gint _add_tab(FmMainWin* win, FmTabPage* page)
 {
-    FmTabPage* page = fm_tab_page_new(path);
     GtkWidget* gpage = GTK_WIDGET(page);
     FmTabLabel* label = page->tab_label;
     FmFolderView* folder_view = fm_tab_page_get_folder_view(page);
@@ -1676,11 +1675,33 @@ gint fm_main_win_add_tab(FmMainWin* win, FmPath* path)
     ret = gtk_notebook_append_page(win->notebook, gpage, GTK_WIDGET(page->tab_label));
     gtk_widget_show_all(gpage);
     gtk_notebook_set_tab_reorderable(win->notebook, gpage, TRUE);
-    gtk_notebook_set_current_page(win->notebook, ret);
 
     return ret;
 }
 
+gint fm_main_win_add_tab(FmMainWin* win, FmPath* path)
+{
+    gint ret = _add_tab(win, fm_tab_page_new(path));
+
+    gtk_notebook_set_current_page(win->notebook, ret);
+    return ret;
+}
+
+/* adds tab without switching to it; if lazy_tabs is set then the folder
+   will be loaded only when user switches to the tab */
+gint fm_main_win_add_tab_in_background(FmMainWin* win, FmPath* path)
+{
+    FmTabPage *page;
+
+    if (app_config->lazy_tabs)
+        return _add_tab(win, fm_tab_page_new_deferred(path));
+    page = fm_tab_page_new(path);
+    /* the tab may be never shown so let it be unloaded as well */
+    if (app_config->tab_unload_timeout > 0)
+        fm_tab_page_schedule_unload(page, app_config->tab_unload_timeout * 60);
+    return _add_tab(win, page);
+}
+
 static gboolean on_window_state_event(GtkWidget *widget, GdkEventWindowState *evt, FmMainWin *win)
 {
     if (evt->changed_mask & GDK_WINDOW_STATE_FULLSCREEN)
@@ -2227,6 +2248,8 @@ static void on_notebook_switch_page(GtkNotebook* nb, gpointer* new_page, guint n
 
     g_return_if_fail(FM_IS_TAB_PAGE(sw_page));
     page = (FmTabPage*)sw_page;
+    /* page might be added in background and not loaded yet */
+    fm_tab_page_load_pending(page);
     /* deactivate gestures from old view first */
     if(win->folder_view)
     {
@@ -2237,6 +2260,9 @@ static void on_notebook_switch_page(GtkNotebook* nb, gpointer* new_page, guint n
     /* remember old views for checks below */
     if (win->current_page)
     {
+        if (win->current_page != page && app_config->tab_unload_timeout > 0)
+            fm_tab_page_schedule_unload(win->current_page,
+                                        app_config->tab_unload_timeout * 60);
         passive_view = fm_tab_page_get_passive_view(win->current_page);
         old_view = fm_tab_page_get_folder_view(win->current_page);
     }
@@ -2260,11 +2286,14 @@ static void on_notebook_switch_page(GtkNotebook* nb, gpointer* new_page, guint n
             win->passive_view_on_right = win->passive_view_on_right ? FALSE : TRUE;
             passive_view = old_view;
         }
+        psv_page = _find_tab_page(win, passive_view);
+        /* passive page might be never shown or unloaded yet */
+        if (psv_page)
+            fm_tab_page_load_pending(psv_page);
         /* now set it */
         fm_tab_page_set_passive_view(page, passive_view, win->passive_view_on_right);
         /* FIXME: log errors */
         /* ok, passive view was just changed, we have to update the button */
-        psv_page = _find_tab_page(win, passive_view);
         if (psv_page)
             gtk_widget_set_state(GTK_WIDGET(psv_page->tab_label), GTK_STATE_SELECTED);
     }
@@ -2653,6 +2682,8 @@ static void on_dual_pane(GtkToggleAction* act, FmMainWin* win)
             g_debug("on_dual_pane: adding passive page %d to left pane", num - 2);
             page = gtk_notebook_get_nth_page(win->notebook, num - 2);
         }
+        /* the page might be added in background and not loaded yet */
+        fm_tab_page_load_pending(FM_TAB_PAGE(page));
         fv = fm_tab_page_get_folder_view(FM_TAB_PAGE(page));
         fm_tab_page_set_passive_view(win->current_page, fv,
                                      win->passive_view_on_right);
@@ -85,6 +85,7 @@ FmMainWin*  fm_main_win_new             (void);
 void fm_main_win_chdir(FmMainWin* win, FmPath* path);
 void fm_main_win_chdir_by_name(FmMainWin* win, const char* path_str);
 gint fm_main_win_add_tab(FmMainWin* win, FmPath* path);
+gint fm_main_win_add_tab_in_background(FmMainWin* win, FmPath* path);
 FmMainWin* fm_main_win_add_win(FmMainWin* win, FmPath* path);
 
 FmMainWin* fm_main_win_get_last_active(void);
@@ -293,6 +293,7 @@ int main(int argc, char** argv)
             g_source_remove(save_config_idle);
             save_config_idle = 0;
         }
+        fm_tab_page_prefetch_finalize();
         fm_volume_manager_finalize();
     }
 
@@ -573,7 +574,12 @@ gboolean pcmanfm_open_folder(GAppLaunchContext* ctx, GList* folder_infos, gpoint
     for(; l; l=l->next)
     {
         FmFileInfo* fi = (FmFileInfo*)l->data;
-        fm_main_win_open_in_last_active(fm_file_info_get_path(fi));
+        FmMainWin *win = fm_main_win_get_last_active();
+        /* only the last folder will be shown, open others in background */
+        if (l->next && win)
+            fm_main_win_add_tab_in_background(win, fm_file_info_get_path(fi));
+        else
+            fm_main_win_open_in_last_active(fm_file_info_get_path(fi));
     }
     if(user_data && FM_IS_DESKTOP(user_data))
         move_window_to_desktop(fm_main_win_get_last_active(), user_data);
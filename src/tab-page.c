@@ -33,6 +33,7 @@
 #include "gseal-gtk-compat.h"
 
 #include <stdlib.h>
+#include <string.h>
 #include <fnmatch.h>
 
 /* Additional entries for FmFileMenu popup */
@@ -79,6 +80,8 @@ static void on_folder_fs_info(FmFolder* folder, FmTabPage* page);
 static void on_folder_start_loading(FmFolder* folder, FmTabPage* page);
 static void on_folder_finish_loading(FmFolder* folder, FmTabPage* page);
 static void on_folder_removed(FmFolder* folder, FmTabPage* page);
+static void on_pending_folder_changed(GFileMonitor *mon, GFile *gf, GFile *other,
+                                      GFileMonitorEvent evt, FmTabPage *page);
 static void on_folder_unmount(FmFolder* folder, FmTabPage* page);
 static void on_folder_content_changed(FmFolder* folder, FmTabPage* page);
 static FmJobErrorAction on_folder_error(FmFolder* folder, GError* err, FmJobErrorSeverity severity, FmTabPage* page);
@@ -184,9 +187,15 @@ static void fm_tab_page_finalize(GObject *object)
 
     for(i = 0; i < FM_STATUS_TEXT_NUM; ++i)
         g_free(page->status_text[i]);
+    if (page->pending_path)
+        fm_path_unref(page->pending_path);
+    if (page->saved_sel)
+        fm_path_list_unref(page->saved_sel);
 
 #if FM_CHECK_VERSION(1, 0, 2)
     g_free(page->filter_pattern);
+    if (page->filter_passed)
+        g_hash_table_destroy(page->filter_passed);
 #endif
 
     G_OBJECT_CLASS(fm_tab_page_parent_class)->finalize(object);
@@ -281,6 +290,8 @@ void fm_tab_page_destroy(GtkObject *object)
 
     g_debug("fm_tab_page_destroy, folder: %s",
             page->folder ? fm_path_get_basename(fm_folder_get_path(page->folder)) : "(none)");
+    fm_tab_page_schedule_unload(page, 0);
+    _unwatch_pending_path(page);
     free_folder(page);
     if(page->nav_history)
     {
@@ -566,18 +577,117 @@ static void _tab_unset_busy_cursor(FmTabPage* page)
 }
 
 #if FM_CHECK_VERSION(1, 0, 2)
-static gboolean fm_tab_page_path_filter(FmFileInfo *file, gpointer user_data)
+/* ---- path filter ----
+ * The pattern is casefolded and normalized once, and simple patterns are
+ * compared as literals. Names which are pure ASCII don't need folding nor
+ * normalization so they are matched without any allocation. */
+enum
 {
-    FmTabPage *page;
-    const char *disp_name;
+    FILTER_MATCH_GLOB, /* generic pattern, use fnmatch() */
+    FILTER_MATCH_ALL, /* "*" */
+    FILTER_MATCH_EXACT, /* "abc" */
+    FILTER_MATCH_PREFIX, /* "abc*" */
+    FILTER_MATCH_SUFFIX, /* "*abc" */
+    FILTER_MATCH_SUBSTRING /* "*abc*" */
+};
+
+static void fm_tab_page_compile_filter(FmTabPage *page)
+{
+    const char *pattern = page->filter_pattern;
+    gsize len = strlen(pattern);
+    gboolean head, tail;
+
+    head = (pattern[0] == '*');
+    tail = (len > (gsize)head && pattern[len - 1] == '*');
+    page->filter_literal = pattern + head;
+    page->filter_literal_len = len - head - tail;
+    if (memchr(page->filter_literal, '*', page->filter_literal_len) ||
+        strpbrk(pattern, "?[\\"))
+        page->filter_match = FILTER_MATCH_GLOB;
+    else if (page->filter_literal_len == 0)
+        page->filter_match = head ? FILTER_MATCH_ALL : FILTER_MATCH_EXACT;
+    else if (head && tail)
+        page->filter_match = FILTER_MATCH_SUBSTRING;
+    else if (head)
+        page->filter_match = FILTER_MATCH_SUFFIX;
+    else if (tail)
+        page->filter_match = FILTER_MATCH_PREFIX;
+    else
+        page->filter_match = FILTER_MATCH_EXACT;
+}
+
+static gboolean _ascii_match_substring(const char *str, gsize len,
+                                       const char *sub, gsize sub_len)
+{
+    gsize i;
+
+    for (i = 0; i + sub_len <= len; i++)
+        if (g_ascii_strncasecmp(str + i, sub, sub_len) == 0)
+            return TRUE;
+    return FALSE;
+}
+
+/* returns TRUE if every name matching the new pattern matches the old one */
+static gboolean _filter_is_narrower(guint old_match, const char *old_lit, gsize old_len,
+                                    guint new_match, const char *new_lit, gsize new_len)
+{
+    if (old_match == FILTER_MATCH_ALL)
+        return TRUE;
+    if (new_match == FILTER_MATCH_GLOB || new_match == FILTER_MATCH_ALL ||
+        new_len < old_len)
+        return FALSE;
+    switch (old_match)
+    {
+    case FILTER_MATCH_PREFIX:
+        return ((new_match == FILTER_MATCH_PREFIX || new_match == FILTER_MATCH_EXACT) &&
+                strncmp(new_lit, old_lit, old_len) == 0);
+    case FILTER_MATCH_SUFFIX:
+        return ((new_match == FILTER_MATCH_SUFFIX || new_match == FILTER_MATCH_EXACT) &&
+                strncmp(new_lit + new_len - old_len, old_lit, old_len) == 0);
+    case FILTER_MATCH_SUBSTRING:
+        for (; new_len >= old_len; new_lit++, new_len--)
+            if (strncmp(new_lit, old_lit, old_len) == 0)
+                return TRUE;
+        return FALSE;
+    }
+    return FALSE;
+}
+
+static gboolean _fm_tab_page_path_filter(FmTabPage *page, FmFileInfo *file)
+{
+    const char *disp_name, *lit;
     char *casefold, *key;
+    gsize len, lit_len;
     gboolean result;
 
-    g_return_val_if_fail(FM_IS_TAB_PAGE(user_data), FALSE);
-    page = (FmTabPage*)user_data;
-    if (page->filter_pattern == NULL)
+    if (page->filter_pattern == NULL || page->filter_match == FILTER_MATCH_ALL)
         return TRUE;
     disp_name = fm_file_info_get_disp_name(file);
+    for (len = 0; disp_name[len]; len++)
+        if ((guchar)disp_name[len] >= 0x80)
+            break;
+    if (disp_name[len] == '\0')
+    {
+        /* ASCII name: casefolding is just lowering the case */
+        lit = page->filter_literal;
+        lit_len = page->filter_literal_len;
+        switch (page->filter_match)
+        {
+        case FILTER_MATCH_EXACT:
+            return (len == lit_len && g_ascii_strncasecmp(disp_name, lit, len) == 0);
+        case FILTER_MATCH_PREFIX:
+            return (len >= lit_len && g_ascii_strncasecmp(disp_name, lit, lit_len) == 0);
+        case FILTER_MATCH_SUFFIX:
+            return (len >= lit_len &&
+                    g_ascii_strncasecmp(disp_name + len - lit_len, lit, lit_len) == 0);
+        case FILTER_MATCH_SUBSTRING:
+            return _ascii_match_substring(disp_name, len, lit, lit_len);
+#ifdef FNM_CASEFOLD
+        default:
+            return (fnmatch(page->filter_pattern, disp_name, FNM_CASEFOLD) == 0);
+#endif
+        }
+    }
     casefold = g_utf8_casefold(disp_name, -1);
     key = g_utf8_normalize(casefold, -1, G_NORMALIZE_ALL);
     g_free(casefold);
@@ -585,7 +695,222 @@ static gboolean fm_tab_page_path_filter(FmFileInfo *file, gpointer user_data)
     g_free(key);
     return result;
 }
+
+/* wrapper which remembers files which passed while refiltering, so if
+   pattern is narrowed only those files need to be tested again */
+static gboolean fm_tab_page_path_filter(FmFileInfo *file, gpointer user_data)
+{
+    FmTabPage *page;
+
+    g_return_val_if_fail(FM_IS_TAB_PAGE(user_data), FALSE);
+    page = (FmTabPage*)user_data;
+    if (page->filter_prev && !g_hash_table_lookup(page->filter_prev, file))
+        return FALSE;
+    if (!_fm_tab_page_path_filter(page, file))
+        return FALSE;
+    if (page->filter_refiltering)
+        g_hash_table_insert(page->filter_passed, file, file);
+    else
+        /* file added after refiltering, filter_passed is incomplete now */
+        page->filter_incomplete = TRUE;
+    return TRUE;
+}
+
+/* applies filters to the model; if the pattern was narrowed then files
+   which didn't pass the filter before are rejected without testing */
+static void fm_tab_page_refilter(FmTabPage *page, FmFolderModel *model,
+                                 gboolean narrower)
+{
+    if (page->filter_passed && narrower && !page->filter_incomplete)
+        page->filter_prev = page->filter_passed;
+    else if (page->filter_passed)
+        g_hash_table_destroy(page->filter_passed);
+    if (page->filter_pattern)
+        page->filter_passed = g_hash_table_new(g_direct_hash, g_direct_equal);
+    else
+        page->filter_passed = NULL;
+    page->filter_incomplete = FALSE;
+    page->filter_refiltering = (page->filter_passed != NULL);
+    fm_folder_model_apply_filters(model);
+    page->filter_refiltering = FALSE;
+    if (page->filter_prev)
+    {
+        g_hash_table_destroy(page->filter_prev);
+        page->filter_prev = NULL;
+    }
+}
+#endif
+
+/* ---- folder prefetching ----
+ * Folders which are likely to be opened next (parent folder, neighbours in
+ * the navigation history, folder just left) are kept referenced so going
+ * there doesn't reload them. Only one folder is loaded at a time, from low
+ * priority idle, and the cache is limited both in folders and files. */
+#define PREFETCH_MAX_FOLDERS 8
+#define PREFETCH_MAX_FILES 50000
+
+static GQueue prefetched = G_QUEUE_INIT; /* FmFolder, most recent first */
+static GQueue prefetch_paths = G_QUEUE_INIT; /* FmPath to load yet */
+static FmFolder *prefetch_loading = NULL;
+static guint prefetch_idle = 0;
+
+static void on_prefetch_finish_loading(FmFolder *folder, gpointer unused);
+static gboolean on_prefetch_idle(gpointer unused);
+
+static void _prefetch_schedule(void)
+{
+    if (prefetch_idle == 0 && prefetch_paths.length > 0)
+        prefetch_idle = gdk_threads_add_idle_full(G_PRIORITY_LOW,
+                                                  on_prefetch_idle, NULL, NULL);
+}
+
+static void _prefetch_trim(void)
+{
+    FmFolder *folder;
+    FmFileInfoList *files;
+    GList *l;
+    guint n_files = 0;
+
+    for (l = prefetched.head; l; l = l->next)
+    {
+        files = fm_folder_get_files(l->data);
+        if (files)
+            n_files += fm_file_info_list_get_length(files);
+    }
+    /* drop least recently used folders until we fit limits */
+    while (prefetched.length > PREFETCH_MAX_FOLDERS ||
+           (prefetched.length > 1 && n_files > PREFETCH_MAX_FILES))
+    {
+        folder = g_queue_pop_tail(&prefetched);
+        files = fm_folder_get_files(folder);
+        if (files)
+            n_files -= MIN(n_files, fm_file_info_list_get_length(files));
+        if (folder == prefetch_loading)
+        {
+            g_signal_handlers_disconnect_by_func(folder, on_prefetch_finish_loading, NULL);
+            prefetch_loading = NULL;
+            /* nothing else will continue with queued paths */
+            _prefetch_schedule();
+        }
+        g_object_unref(folder);
+    }
+}
+
+/* takes reference on folder and puts it on top of the cache */
+static void _prefetch_keep(FmFolder *folder)
+{
+    GList *l = g_queue_find(&prefetched, folder);
+
+    if (l)
+        g_queue_delete_link(&prefetched, l);
+    else
+        g_object_ref(folder);
+    g_queue_push_head(&prefetched, folder);
+}
+
+static gboolean on_prefetch_idle(gpointer unused)
+{
+    FmPath *path;
+    FmFolder *folder;
+
+    if (g_source_is_destroyed(g_main_current_source()))
+        return FALSE;
+    prefetch_idle = 0;
+    while (prefetch_loading == NULL &&
+           (path = g_queue_pop_head(&prefetch_paths)) != NULL)
+    {
+        folder = fm_folder_from_path(path);
+        fm_path_unref(path);
+        _prefetch_keep(folder);
+        if (!fm_folder_is_loaded(folder))
+        {
+            prefetch_loading = folder;
+            g_signal_connect(folder, "finish-loading",
+                             G_CALLBACK(on_prefetch_finish_loading), NULL);
+        }
+        g_object_unref(folder);
+    }
+    _prefetch_trim();
+    return FALSE;
+}
+
+static void on_prefetch_finish_loading(FmFolder *folder, gpointer unused)
+{
+    g_signal_handlers_disconnect_by_func(folder, on_prefetch_finish_loading, NULL);
+    prefetch_loading = NULL;
+    /* continue with next folder */
+    _prefetch_schedule();
+}
+
+/* drops everything prefetched, used on exit or if prefetch is disabled */
+void fm_tab_page_prefetch_finalize(void)
+{
+    FmPath *path;
+    FmFolder *folder;
+
+    if (prefetch_idle)
+    {
+        g_source_remove(prefetch_idle);
+        prefetch_idle = 0;
+    }
+    if (prefetch_loading)
+    {
+        g_signal_handlers_disconnect_by_func(prefetch_loading,
+                                             on_prefetch_finish_loading, NULL);
+        prefetch_loading = NULL;
+    }
+    while ((path = g_queue_pop_head(&prefetch_paths)) != NULL)
+        fm_path_unref(path);
+    while ((folder = g_queue_pop_head(&prefetched)) != NULL)
+        g_object_unref(folder);
+}
+
+static void _prefetch_path(FmPath *path)
+{
+    GList *l;
+
+    /* don't load remote or virtual folders just in case */
+    if (path == NULL || !fm_path_is_native(path))
+        return;
+    for (l = prefetch_paths.head; l; l = l->next)
+        if (fm_path_equal(l->data, path))
+            return;
+    /* paths queued last are loaded first, so queue most likely ones last */
+    g_queue_push_head(&prefetch_paths, fm_path_ref(path));
+    if (prefetch_paths.length > PREFETCH_MAX_FOLDERS)
+        fm_path_unref(g_queue_pop_tail(&prefetch_paths));
+    _prefetch_schedule();
+}
+
+/* queues folders which the user may open next from this page */
+static void fm_tab_page_prefetch(FmTabPage *page)
+{
+    FmPath *cwd = fm_folder_get_path(page->folder);
+#if FM_CHECK_VERSION(1, 0, 2)
+    guint idx = fm_nav_history_get_cur_index(page->nav_history);
+#else
+    const GList *cur = fm_nav_history_get_cur_link(page->nav_history);
+#endif
+
+    if (!app_config->folder_prefetch)
+    {
+        /* it might be just disabled */
+        fm_tab_page_prefetch_finalize();
+        return;
+    }
+
+    _prefetch_path(fm_path_get_parent(cwd));
+#if FM_CHECK_VERSION(1, 0, 2)
+    if (idx > 0)
+        _prefetch_path(fm_nav_history_get_nth_path(page->nav_history, idx - 1));
+    _prefetch_path(fm_nav_history_get_nth_path(page->nav_history, idx + 1));
+#else
+    if (cur && cur->prev)
+        _prefetch_path(((FmNavHistoryItem*)cur->prev->data)->path);
+    if (cur && cur->next)
+        _prefetch_path(((FmNavHistoryItem*)cur->next->data)->path);
 #endif
+}
 
 static void on_folder_start_loading(FmFolder* folder, FmTabPage* page)
 {
@@ -604,7 +929,7 @@ static void on_folder_start_loading(FmFolder* folder, FmTabPage* page)
         if (page->filter_pattern)
         {
             fm_folder_model_add_filter(model, fm_tab_page_path_filter, page);
-            fm_folder_model_apply_filters(model);
+            fm_tab_page_refilter(page, model, FALSE);
         }
         fm_folder_view_set_model(fv, model);
         fm_folder_model_set_sort(model, page->sort_by, page->sort_type);
@@ -643,6 +968,13 @@ static gboolean update_scroll(gpointer data)
         page->want_focus = NULL;
     }
 #endif
+    if (page->saved_sel)
+    {
+        /* restore selection which was before the page was unloaded */
+        fm_folder_view_select_file_paths(page->folder_view, page->saved_sel);
+        fm_path_list_unref(page->saved_sel);
+        page->saved_sel = NULL;
+    }
     page->update_scroll_id = 0;
     return FALSE;
 }
@@ -667,7 +999,7 @@ static void on_folder_finish_loading(FmFolder* folder, FmTabPage* page)
         if (page->filter_pattern)
         {
             fm_folder_model_add_filter(model, fm_tab_page_path_filter, page);
-            fm_folder_model_apply_filters(model);
+            fm_tab_page_refilter(page, model, FALSE);
         }
         /* since 1.0.2 sorting should be applied on model instead of view */
         fm_folder_model_set_sort(model, page->sort_by, page->sort_type);
@@ -691,6 +1023,7 @@ static void on_folder_finish_loading(FmFolder* folder, FmTabPage* page)
                   page->status_text[FM_STATUS_TEXT_NORMAL]);
 
     _tab_unset_busy_cursor(page);
+    fm_tab_page_prefetch(page);
     /* g_debug("finish-loading"); */
     g_signal_emit(page, signals[LOADED], 0);
 }
@@ -1010,6 +1343,227 @@ FmTabPage *fm_tab_page_new(FmPath* path)
     return page;
 }
 
+/* sets path to load later and updates tab label for it */
+static void _set_pending_path(FmTabPage* page, FmPath* path)
+{
+    char *disp_name = fm_path_display_basename(path);
+    char *disp_path = fm_path_display_name(path, FALSE);
+
+    fm_tab_label_set_text(page->tab_label, disp_name);
+    fm_tab_label_set_tooltip_text(page->tab_label, disp_path);
+    g_free(disp_name);
+    g_free(disp_path);
+    if (page->pending_path)
+        fm_path_unref(page->pending_path);
+    page->pending_path = fm_path_ref(path);
+}
+
+FmTabPage *fm_tab_page_new_deferred(FmPath* path)
+{
+    FmTabPage* page = (FmTabPage*)g_object_new(FM_TYPE_TAB_PAGE, NULL);
+
+    /* only set label now, folder will be loaded when page is shown */
+    _set_pending_path(page, path);
+    return page;
+}
+
+static void _unwatch_pending_path(FmTabPage* page)
+{
+    if (page->pending_mon)
+    {
+        g_signal_handlers_disconnect_by_func(page->pending_mon,
+                                             on_pending_folder_changed, page);
+        g_file_monitor_cancel(page->pending_mon);
+        g_object_unref(page->pending_mon);
+        page->pending_mon = NULL;
+    }
+}
+
+/* unloaded folder was deleted or unmounted, do the same what
+   on_folder_removed() does for the loaded folder */
+static void on_pending_folder_changed(GFileMonitor *mon, GFile *gf, GFile *other,
+                                      GFileMonitorEvent evt, FmTabPage *page)
+{
+    FmPath *path;
+    gboolean is_self;
+
+    if (evt != G_FILE_MONITOR_EVENT_DELETED && evt != G_FILE_MONITOR_EVENT_UNMOUNTED)
+        return;
+    path = fm_path_new_for_gfile(gf);
+    is_self = fm_path_equal(path, page->pending_path);
+    fm_path_unref(path);
+    if (!is_self)
+        return;
+    _unwatch_pending_path(page);
+    if (app_config->close_on_unmount)
+    {
+        gtk_widget_destroy(GTK_WIDGET(page));
+        return;
+    }
+    /* the tab will go home when shown, no state to restore there */
+    page->unloaded = FALSE;
+    if (page->saved_sel)
+    {
+        fm_path_list_unref(page->saved_sel);
+        page->saved_sel = NULL;
+    }
+#if FM_CHECK_VERSION(1, 2, 0)
+    if (app_config->home_path && app_config->home_path[0])
+    {
+        path = fm_path_new_for_str(app_config->home_path);
+        _set_pending_path(page, path);
+        fm_path_unref(path);
+    }
+    else
+#endif
+        _set_pending_path(page, fm_path_get_home());
+}
+
+/**
+ * fm_tab_page_load_pending
+ * @page: the page instance
+ *
+ * Loads the folder of page created with fm_tab_page_new_deferred() if
+ * it was not loaded yet.
+ *
+ * Returns: %TRUE if folder loading was started.
+ */
+gboolean fm_tab_page_load_pending(FmTabPage* page)
+{
+    FmPath *path = page->pending_path;
+#if FM_CHECK_VERSION(1, 0, 2)
+    FmSortMode sort_type;
+    FmFolderModelCol sort_by;
+    FmFolderModel *model;
+#endif
+
+    fm_tab_page_schedule_unload(page, 0);
+    if (path == NULL)
+        return FALSE;
+    _unwatch_pending_path(page);
+    page->pending_path = NULL;
+    if (page->unloaded)
+    {
+        /* history and scroll position are kept from fm_tab_page_unload() */
+        page->unloaded = FALSE;
+#if FM_CHECK_VERSION(1, 0, 2)
+        sort_type = page->sort_type;
+        sort_by = page->sort_by;
+#endif
+        fm_tab_page_chdir_without_history(page, path);
+        /* view settings might be changed in this tab, keep them */
+        fm_standard_view_set_mode(FM_STANDARD_VIEW(page->folder_view),
+                                  page->saved_view_mode);
+        page->view_mode = page->saved_view_mode;
+        fm_tab_page_set_show_hidden(page, page->saved_show_hidden);
+        page->show_hidden = page->saved_show_hidden;
+#if FM_CHECK_VERSION(1, 0, 2)
+        /* the user might change sorting in this tab, keep it */
+        page->sort_type = sort_type;
+        page->sort_by = sort_by;
+        model = fm_folder_view_get_model(page->folder_view);
+        if (model)
+            fm_folder_model_set_sort(model, sort_by, sort_type);
+#endif
+    }
+    else
+        fm_tab_page_chdir(page, path);
+    fm_path_unref(path);
+    return TRUE;
+}
+
+/* drops folder and model of the page but keeps its path, history, scroll
+   position and selection so it can be loaded later when page is shown */
+static gboolean fm_tab_page_unload(FmTabPage* page)
+{
+    GtkAdjustment *vadjustment;
+    FmFileInfoList *files;
+    FmPath *path;
+    GFile *gf;
+    char *disp_path, *tooltip;
+    guint n_files;
+    int scroll_pos;
+
+    if (page->pending_path || page->folder == NULL)
+        return FALSE;
+    vadjustment = gtk_scrolled_window_get_vadjustment(GTK_SCROLLED_WINDOW(page->folder_view));
+    scroll_pos = gtk_adjustment_get_value(vadjustment);
+#if FM_CHECK_VERSION(1, 0, 2)
+    fm_nav_history_go_to(page->nav_history,
+                         fm_nav_history_get_cur_index(page->nav_history),
+                         scroll_pos);
+#else
+    /* NOTE: ignoring const modifier due to invalid pre-1.0.2 design */
+    ((FmNavHistoryItem*)fm_nav_history_get_cur(page->nav_history))->scroll_pos = scroll_pos;
+#endif
+    if (page->saved_sel)
+        fm_path_list_unref(page->saved_sel);
+    page->saved_sel = fm_folder_view_dup_selected_file_paths(page->folder_view);
+    page->saved_view_mode = fm_standard_view_get_mode(FM_STANDARD_VIEW(page->folder_view));
+    page->saved_show_hidden = fm_folder_view_get_show_hidden(page->folder_view);
+    files = fm_folder_get_files(page->folder);
+    n_files = files ? fm_file_info_list_get_length(files) : 0;
+    path = fm_folder_get_path(page->folder);
+    page->pending_path = fm_path_ref(path);
+    page->unloaded = TRUE;
+    free_folder(page);
+    fm_folder_view_set_model(page->folder_view, NULL);
+    /* watch the folder so the tab is closed if it is deleted or unmounted */
+    gf = fm_path_to_gfile(path);
+    page->pending_mon = g_file_monitor_directory(gf, G_FILE_MONITOR_WATCH_MOUNTS,
+                                                 NULL, NULL);
+    g_object_unref(gf);
+    if (page->pending_mon)
+        g_signal_connect(page->pending_mon, "changed",
+                         G_CALLBACK(on_pending_folder_changed), page);
+    /* let the user know how much was released from this tab */
+    disp_path = fm_path_display_name(path, FALSE);
+    tooltip = g_strdup_printf(ngettext("%s\n(unloaded, %u item released)",
+                                       "%s\n(unloaded, %u items released)",
+                                       n_files), disp_path, n_files);
+    fm_tab_label_set_tooltip_text(page->tab_label, tooltip);
+    g_debug("unloading idle tab %s, %u files dropped", disp_path, n_files);
+    g_free(tooltip);
+    g_free(disp_path);
+    return TRUE;
+}
+
+static gboolean on_unload_timeout(gpointer user_data)
+{
+    FmTabPage *page = user_data;
+
+    if (g_source_is_destroyed(g_main_current_source()))
+        return FALSE;
+    /* the view may be still visible as passive view of other page */
+    if (gtk_widget_get_mapped(GTK_WIDGET(page->folder_view)))
+        return TRUE;
+    page->unload_id = 0;
+    fm_tab_page_unload(page);
+    return FALSE;
+}
+
+/**
+ * fm_tab_page_schedule_unload
+ * @page: the page instance
+ * @timeout: time in seconds
+ *
+ * Schedules dropping folder of hidden page after @timeout seconds. The
+ * page will be reloaded by fm_tab_page_load_pending(). If @timeout is 0
+ * then cancels scheduled unloading.
+ */
+void fm_tab_page_schedule_unload(FmTabPage* page, guint timeout)
+{
+    if (page->unload_id)
+    {
+        g_source_remove(page->unload_id);
+        page->unload_id = 0;
+    }
+    if (timeout > 0 && page->folder)
+        page->unload_id = gdk_threads_add_timeout_seconds(timeout,
+                                                          on_unload_timeout,
+                                                          page);
+}
+
 static void fm_tab_page_chdir_without_history(FmTabPage* page, FmPath* path)
 {
     char* disp_name = fm_path_display_basename(path);
@@ -1048,6 +1602,14 @@ static void fm_tab_page_chdir_without_history(FmTabPage* page, FmPath* path)
     fm_tab_label_set_tooltip_text(FM_TAB_LABEL(page->tab_label), disp_path);
     g_free(disp_path);
 
+    /* the user may return to the folder soon, keep it loaded for a while */
+    if (app_config->folder_prefetch && page->folder &&
+        fm_folder_is_loaded(page->folder) &&
+        fm_path_is_native(fm_folder_get_path(page->folder)))
+    {
+        _prefetch_keep(page->folder);
+        _prefetch_trim();
+    }
     free_folder(page);
 
     page->folder = fm_folder_from_path(path);
@@ -1149,6 +1711,20 @@ void fm_tab_page_chdir(FmTabPage* page, FmPath* path)
 {
     FmPath* cwd = fm_tab_page_get_cwd(page);
     int scroll_pos;
+    if (page->pending_path)
+    {
+        /* the page was never shown so just forget what it should load */
+        _unwatch_pending_path(page);
+        fm_path_unref(page->pending_path);
+        page->pending_path = NULL;
+        page->unloaded = FALSE;
+        cwd = NULL;
+    }
+    if (page->saved_sel)
+    {
+        fm_path_list_unref(page->saved_sel);
+        page->saved_sel = NULL;
+    }
     if(cwd && path && fm_path_equal(cwd, path))
         return;
     scroll_pos = gtk_adjustment_get_value(gtk_scrolled_window_get_vadjustment(GTK_SCROLLED_WINDOW(page->folder_view)));
@@ -1172,6 +1748,8 @@ void fm_tab_page_set_show_hidden(FmTabPage* page, gboolean show_hidden)
 
 FmPath* fm_tab_page_get_cwd(FmTabPage* page)
 {
+    if (page->pending_path)
+        return page->pending_path;
     return page->folder ? fm_folder_get_path(page->folder) : NULL;
 }
 
@@ -1410,7 +1988,8 @@ FmFolderView *fm_tab_page_get_passive_view(FmTabPage *page)
 void fm_tab_page_set_filter_pattern(FmTabPage *page, const char *pattern)
 {
     FmFolderModel *model = NULL;
-    char *disp_name;
+    char *disp_name, *old_pattern;
+    gboolean narrower = FALSE;
 
     /* validate pattern */
     if (pattern && pattern[0] == '\0')
@@ -1428,18 +2007,34 @@ void fm_tab_page_set_filter_pattern(FmTabPage *page, const char *pattern)
             fm_folder_model_remove_filter(model, fm_tab_page_path_filter, page);
     }
     /* update page own data */
-    g_free(page->filter_pattern);
+    old_pattern = page->filter_pattern;
     if (pattern)
     {
         char *casefold = g_utf8_casefold(pattern, -1);
+        guint old_match = page->filter_match;
+        const char *old_lit = page->filter_literal;
+        gsize old_len = page->filter_literal_len;
+
         page->filter_pattern = g_utf8_normalize(casefold, -1, G_NORMALIZE_ALL);
         g_free(casefold);
+        fm_tab_page_compile_filter(page);
+        /* if the pattern was only extended then hidden files stay hidden */
+        narrower = old_pattern && _filter_is_narrower(old_match, old_lit, old_len,
+                                                      page->filter_match,
+                                                      page->filter_literal,
+                                                      page->filter_literal_len);
     }
     else
         page->filter_pattern = NULL;
+    g_free(old_pattern);
     /* apply changes if needed */
     if (model)
-        fm_folder_model_apply_filters(model);
+        fm_tab_page_refilter(page, model, narrower);
+    else if (page->filter_passed)
+    {
+        g_hash_table_destroy(page->filter_passed);
+        page->filter_passed = NULL;
+    }
     /* update tab page title */
     disp_name = fm_path_display_basename(fm_folder_view_get_cwd(page->folder_view));
     if (page->filter_pattern)
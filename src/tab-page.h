@@ -62,6 +62,10 @@ struct _FmTabPage
     char* status_text[FM_STATUS_TEXT_NUM];
     FmFolder* folder;
     FmDndDest *dd; /* handler for drop on label */
+    FmPath *pending_path; /* folder to load when the page is shown first time */
+    FmPathList *saved_sel; /* selection to restore after page was unloaded */
+    GFileMonitor *pending_mon; /* watches pending_path after page was unloaded */
+    guint saved_view_mode; /* view mode to restore after page was unloaded */
 #if FM_CHECK_VERSION(1, 2, 0)
     FmPath *want_focus;
 #endif
@@ -71,6 +75,13 @@ struct _FmTabPage
     FmFolderModelCol sort_by;
     char **columns; /* NULL if own_config is FALSE */
     char *filter_pattern;
+    const char *filter_literal; /* part of filter_pattern to compare with */
+    gsize filter_literal_len;
+    guint filter_match; /* kind of filter_pattern, see tab-page.c */
+    GHashTable *filter_passed; /* files which passed the filter last time */
+    GHashTable *filter_prev; /* filter_passed while refiltering narrower pattern */
+    gboolean filter_refiltering; /* filter_passed is being filled */
+    gboolean filter_incomplete; /* some visible files are not in filter_passed */
 #else
     GtkSortType sort_type;
     int sort_by;
@@ -79,7 +90,10 @@ struct _FmTabPage
     gboolean show_hidden : 1;
     gboolean own_config : 1;
     gboolean busy : 1;
+    gboolean unloaded : 1; /* pending_path is set by fm_tab_page_unload() */
+    gboolean saved_show_hidden : 1;
     guint update_scroll_id;
+    guint unload_id;
 };
 
 struct _FmTabPageClass
@@ -100,6 +114,17 @@ GType fm_tab_page_get_type(void);
 
 FmTabPage* fm_tab_page_new(FmPath* path);
 
+/* create page which doesn't load folder until fm_tab_page_load_pending() */
+FmTabPage* fm_tab_page_new_deferred(FmPath* path);
+
+gboolean fm_tab_page_load_pending(FmTabPage* page);
+
+/* drop folder of page after it was hidden for timeout seconds, 0 cancels */
+void fm_tab_page_schedule_unload(FmTabPage* page, guint timeout);
+
+/* releases folders kept by prefetcher */
+void fm_tab_page_prefetch_finalize(void);
+
 void fm_tab_page_chdir(FmTabPage* page, FmPath* path);
 
 void fm_tab_page_set_show_hidden(FmTabPage* page, gboolean show_hidden);